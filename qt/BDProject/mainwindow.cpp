@@ -163,18 +163,18 @@ void MainWindow::on_pushButton_clicked()
                                     lim.removeAt(1);
                                 int lim1 = atoi(lim.at(0).toUtf8().constData());
                                 int lim2 = atoi(lim.at(1).toUtf8().constData());
-                                std::vector <Default> range;
-                                bool srange = dbconsult.readRecordRange(range, lim1, lim2);
-                                if (srange) {
-                                    for (int i = 0; i < (int) range.size(); i++){
-                                        Default d = range [i];
-                                        ui->tableWidget->insertRow(ui->tableWidget->rowCount());
+                                //the records are streamed to the table, they aren't kept in a vector
+                                long srange = dbconsult.scanRecordRange(lim1, lim2, [this](Default &d){
+                                        int i = ui->tableWidget->rowCount();
+                                        ui->tableWidget->insertRow(i);
                                         ui->tableWidget->setItem(i, 0, new QTableWidgetItem(QString::number(d.id)) );
                                         ui->tableWidget->setItem(i, 1, new QTableWidgetItem(d.description) );
                                         ui->tableWidget->setItem(i, 2, new QTableWidgetItem(d.city) );
                                         ui->tableWidget->setItem(i, 3, new QTableWidgetItem(d.state) );
                                         ui->tableWidget->setItem(i, 4, new QTableWidgetItem(d.weather) );
-                                    }
+                                        return true;
+                                    });
+                                if (srange > 0) {
                                     ui->tableWidget->resizeColumnsToContents();
                                     ui->donebutton->setText("Consulta por rango");
                                 }
@@ -13,12 +13,19 @@
 
 #pragma once
 #include "disk_manager.h"
+#include "buffer_pool.h"
+#include "page_allocator.h"
+#include "page_latches.h"
 #include "b_plus_tree_node.h"
 #include "b_plus_tree_iterator.h"
 #include <memory>
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+#include <shared_mutex>
 
 namespace bd2{
 
@@ -34,68 +41,70 @@ class BPlusTree{
   using node = bd2::Node<T,ORDER>;
   using iterator = bd2::BPlusTreeIterator<T,ORDER>;
   using diskManager = std::shared_ptr<DiskManager>;
+  using bufferPool = std::shared_ptr<BufferPool<node>>;
+  using nodeHandle = PageHandle<node>;
+  using pageAllocator = std::shared_ptr<PageAllocator<node>>;
 
-  enum state { OVERFLOW, NORMAL}; //state of the node insertion
+  enum state { OVERFLOW, NORMAL, UNDERFLOW}; //state of the node insertion or deletion
 
   diskManager disk_manager; // disk manager of the index file
+  bufferPool buffer_pool; // cache of the nodes of the index file
+  pageAllocator allocator; // allocator of the nodes, it keeps the number of nodes and the free nodes
+  std::shared_ptr<PageLatches> latches; // latches of the nodes, they are crabbed from the root to the leaves
+  std::shared_ptr<std::shared_timed_mutex> tree_latch; // shared by searches and insertions, exclusive for erase and bulk load
 
-  //struct to store the starting node and the number of existing nodes
+  //struct to store the starting node, the root never changes its position
   struct Header{
       long disk_id = 1;
-      long n_nodes = 0;
   } header;
 
   protected:
 
     /**
-     * @brief Create a Node object by a isLeaf flag
+     * @brief Create a node in a frame of the buffer pool, the page isn't
+     * read because it is initialized
      *
+     * @param disk_id position of the node on disk
      * @param isLeaf if the node is a leaf node
-     * @return node node created
+     * @return nodeHandle node pinned, it is written back when it is replaced
      */
-    node createNode(bool isLeaf){
-        header.n_nodes++; //position of the new node
-        disk_manager->write_record(0, header);
-        node new_node(header.n_nodes, isLeaf);
+    nodeHandle createNode(long disk_id, bool isLeaf){
+        nodeHandle new_node(buffer_pool, disk_id, true);
+        new_node->init(disk_id, isLeaf);
+        new_node.markDirty();
         return new_node;
     }
 
     /**
-     * @brief Create a Node object by a disk_id and isLeaf flag,
-     * Its create a node with the same disk id of a previous one,
-     * it is used in the split function to overwrite an splitted
-     * node with just the left child values
+     * @brief Create a Node object by a isLeaf flag
      *
-     * @param disk_id the disk id of the previous node
-     * @param isLeaf is the node leaf?
-     * @return node node created
+     * @param isLeaf if the node is a leaf node
+     * @return nodeHandle node created
      */
-    node createNode(long disk_id, bool isLeaf){
-        node new_node(disk_id, isLeaf);
-        return new_node;
+    nodeHandle createNode(bool isLeaf){
+        return createNode(allocator->allocate(), isLeaf); //a freed node is reused if exists
     }
 
-
     /**
-     * @brief Read a node from disk by a given disk id position
+     * @brief Add a node to the free list, so its position is reused
+     * by the next created node
      *
-     * @param disk_id
-     * @return node
+     * @param disk_id position of the node on disk
      */
-    node readNode(long disk_id){
-        node new_node(-1);
-        disk_manager->retrieve_record(disk_id, new_node);
-        return new_node;
+    void freeNode(long disk_id){
+        allocator->release(disk_id);
     }
 
     /**
-     * @brief Write a node to disk by a given disk id position
+     * @brief Pin a node in the buffer pool, it is read and modified in
+     * place while the handle lives, so the node isn't copied. The caller
+     * keeps the node latched while it is used
      *
      * @param disk_id
-     * @param n
+     * @return nodeHandle
      */
-    void writeNode(long disk_id, node n){
-        disk_manager->write_record(disk_id, n);
+    nodeHandle pinNode(long disk_id){
+        return nodeHandle(buffer_pool, disk_id);
     }
 
     /**
@@ -105,152 +114,455 @@ class BPlusTree{
      *
      * @param ptr_node
      * @param value
+     * @param held nodes latched in exclusive mode, from the root to ptr_node
      * @return int
      */
-    int insert(node &ptr_node, const T value, const long record_id){
-        int pos = 0;
-
-        //find position on node
-        while (pos < ptr_node.n_keys && ptr_node.keys[pos] < value)
-            pos++;
+    int insert(nodeHandle &ptr_node, const T &value, const long record_id, std::vector<long> &held){
+        int pos = ptr_node->findPosition(value); //find position on node
 
-        if (ptr_node.is_leaf){
-            ptr_node.insertKeyInPosition(pos, value, record_id);       //insert if is a leaf node
-            writeNode(ptr_node.disk_id, ptr_node);
+        if (ptr_node->is_leaf){
+            ptr_node->insertKeyInPosition(pos, value, record_id);       //insert if is a leaf node
+            ptr_node.markDirty();
         } else {        //search for the child node to insert
-            long page_id = ptr_node.children[pos];
-            node child = readNode(page_id);
-            int state = insert(child, value, record_id);
-            if (state == OVERFLOW){
-                splitNode(ptr_node, pos);
-            }
+            long page_id = ptr_node->children[pos];
+            latches->lockExclusive(page_id);
+            held.push_back(page_id);
+            nodeHandle child = pinNode(page_id);
+            if (isSafe(*child)) //the ancestors aren't modified by the insertion
+                releaseAncestors(held);
+            int state = insert(child, value, record_id, held);
+            if (state != OVERFLOW) //the node wasn't modified, it may not be latched anymore
+                return NORMAL;
+            splitNode(ptr_node, pos);
         }
-        return ptr_node.isOverflow() ? OVERFLOW : NORMAL; //the insertion status
+        return ptr_node->isOverflow() ? OVERFLOW : NORMAL; //the insertion status
+    }
+
+    /**
+     * @brief Copy the keys [begin, end) of a node to an empty node, with
+     * their records if it is a leaf or with the children around them if
+     * it is an inner node
+     *
+     * @param from node copied
+     * @param begin first key
+     * @param end end of the keys
+     * @param to node that receives the keys
+     */
+    static void copyKeys(const node &from, int begin, int end, node &to){
+        for (int i = begin; i < end; i++){
+            to.keys[i - begin] = from.keys[i];
+            if (from.is_leaf)
+                to.records_id[i - begin] = from.records_id[i];
+            else
+                to.children[i - begin] = from.children[i];
+        }
+        if (!from.is_leaf)
+            to.children[end - begin] = from.children[end];
+        to.n_keys = end - begin;
     }
 
     /**
      * @brief split the root node in left and write child, by a left based split
      *
+     * @param ptr_node root, it keeps its position
      */
-    void splitRoot() {
-        node ptr_node = readNode(header.disk_id);
-        node left_node = createNode(ptr_node.is_leaf);
-        node right_node = createNode(ptr_node.is_leaf);
+    void splitRoot(nodeHandle &ptr_node) {
+        nodeHandle left_node = createNode(ptr_node->is_leaf);
+        nodeHandle right_node = createNode(ptr_node->is_leaf);
 
-        int iter_child; //for child
-        int iter_keys = 0;//for keys
-        int pos = 0;
+        int middle = ORDER / 2;
+        copyKeys(*ptr_node, 0, ptr_node->is_leaf ? middle + 1 : middle, *left_node); //a leaf keeps the middle key (left based split)
+        copyKeys(*ptr_node, middle + 1, ORDER + 1, *right_node);
 
-        for (iter_child = 0; iter_keys < ORDER / 2; iter_child++) { //copy to left node
-            left_node.children[iter_child] = ptr_node.children[iter_keys];
-            left_node.keys[iter_child] = ptr_node.keys[iter_keys];
-            left_node.records_id[iter_child] = ptr_node.records_id[iter_keys];
-            left_node.n_keys++;
-            iter_keys++;
+        if (ptr_node->is_leaf){ //link the children nodes if is the first split
+            left_node->next_node = right_node->disk_id;
+            right_node->prev_node = left_node->disk_id;
         }
-        left_node.children[iter_child] = ptr_node.children[iter_keys];
 
-        if (ptr_node.is_leaf){ //if is the first split of the root node
-            left_node.keys[iter_child] = ptr_node.keys[iter_keys]; //left base split
-            left_node.records_id[iter_child] = ptr_node.records_id[iter_keys];
-            left_node.n_keys++;
-        }
+        ptr_node->keys[0] = ptr_node->keys[middle];
+        ptr_node->is_leaf = false;
+        //update children array
+        ptr_node->children[0] = left_node->disk_id;
+        ptr_node->children[1] = right_node->disk_id;
+        ptr_node->n_keys = 1;
+        ptr_node.markDirty();
+    }
 
-        iter_keys++;
 
-        for (iter_child = 0; iter_keys < ORDER + 1; iter_child++) {  //copy to right node
-            right_node.children[iter_child] = ptr_node.children[iter_keys];
-            right_node.keys[iter_child] = ptr_node.keys[iter_keys];
-            right_node.records_id[iter_child] = ptr_node.records_id[iter_keys];
-            right_node.n_keys++;
-            iter_keys++;
-        }
+    /**
+     * @brief split a node in left and write child, by a left based split.
+     * The left part stays in place, only the right part is copied to the
+     * new node
+     *
+     * @param parent_node parent of the node to be splitted
+     * @param pos position of the node to be splitted in the parent node
+     */
+    void splitNode (nodeHandle &parent_node, int pos){
+        nodeHandle ptr_node = pinNode(parent_node->children[pos]);
+        nodeHandle right_node = createNode(ptr_node->is_leaf);
+
+        int middle = ORDER / 2;
+        copyKeys(*ptr_node, middle + 1, ORDER + 1, *right_node);
+        T promoted = ptr_node->keys[middle];
 
-        right_node.children[iter_child] = ptr_node.children[iter_keys];
+        if (ptr_node->is_leaf) { //if the node splitted is leaf
+            //update the next and previous nodes
+            right_node->prev_node = ptr_node->disk_id;
+            right_node->next_node = ptr_node->next_node;
+            ptr_node->next_node = right_node->disk_id;
+
+            //update the previous node of the next node before split
+            if (right_node->next_node != -1){
+                latches->lockExclusive(right_node->next_node); //the leaves are latched from left to right
+                nodeHandle temp = pinNode(right_node->next_node);
+                temp->prev_node = right_node->disk_id;
+                temp.markDirty();
+                temp.release();
+                latches->unlockExclusive(right_node->next_node);
+            }
 
-        if (ptr_node.is_leaf){ //link the children nodes if is the first split
-            left_node.next_node = right_node.disk_id;
-            right_node.prev_node = left_node.disk_id;
         }
+        ptr_node->n_keys = ptr_node->is_leaf ? middle + 1 : middle; //a leaf keeps the middle key (left based split)
+        ptr_node.markDirty();
 
+        parent_node->insertSeparatorInPosition(pos, promoted); //key promoted
+        parent_node->children[pos + 1] = right_node->disk_id;
+        parent_node->is_leaf = false; //update the parent to non leaf
+        parent_node.markDirty();
+    }
 
-        //update children array
-        ptr_node.children[pos] = left_node.disk_id;
+    /**
+     * @brief Check if a node can take one more key without a split
+     *
+     * @param ptr_node node to be checked
+     * @return true the node doesn't overflow after an insertion
+     */
+    static bool isSafe(const node &ptr_node){
+        return ptr_node.n_keys < ORDER;
+    }
 
-        ptr_node.keys[0] = ptr_node.keys[ORDER / 2];
-        ptr_node.records_id[0] = ptr_node.records_id[ORDER/2];
-        ptr_node.children[pos + 1] = right_node.disk_id;
-        ptr_node.n_keys = 1;
-        ptr_node.is_leaf = false;
+    /**
+     * @brief Release the exclusive latches of the ancestors of the last
+     * latched node
+     *
+     * @param held nodes latched in exclusive mode, from the root down
+     */
+    void releaseAncestors(std::vector<long> &held){
+        for (size_t i = 0; i + 1 < held.size(); i++)
+            latches->unlockExclusive(held[i]);
+        held.erase(held.begin(), held.end() - 1);
+    }
 
-        writeNode(ptr_node.disk_id, ptr_node);
-        writeNode(left_node.disk_id, left_node);
-        writeNode(right_node.disk_id, right_node);
+    /**
+     * @brief Insert a value latching only the leaf in exclusive mode, the
+     * inner nodes are crabbed with shared latches. It gives up if the
+     * root is a leaf or the leaf is full, because the insertion would split
+     *
+     * @param value value to be inserted
+     * @param record_id position of the record on disk
+     * @return true the value was inserted
+     * @return false the insertion has to latch the path in exclusive mode
+     */
+    bool insertOptimistic(const T value, const long record_id){
+        long page_id = header.disk_id;
+        latches->lockShared(page_id);
+        nodeHandle current = pinNode(page_id);
+        while (!current->is_leaf){
+            long child_id = current->children[current->findPosition(value)];
+            latches->lockShared(child_id);
+            nodeHandle child = pinNode(child_id);
+            if (child->is_leaf){
+                //the shared latch of the parent keeps the leaf from being split meanwhile
+                latches->unlockShared(child_id);
+                latches->lockExclusive(child_id);
+                latches->unlockShared(page_id);
+                bool safe = isSafe(*child);
+                if (safe){
+                    child->insertKeyInPosition(child->findPosition(value), value, record_id);
+                    child.markDirty();
+                }
+                child.release();
+                latches->unlockExclusive(child_id);
+                return safe;
+            }
+            latches->unlockShared(page_id);
+            page_id = child_id;
+            current = std::move(child);
+        }
+        latches->unlockShared(page_id);
+        return false;
     }
 
+    /**
+     * @brief Descend to the leaf in which a value is or has to be, the
+     * child is latched before releasing the parent
+     *
+     * @param val value to be searched
+     * @param disk_access counter of the nodes read
+     * @return nodeHandle leaf pinned, it stays latched in shared mode
+     */
+    nodeHandle findLeaf(const T &val, int &disk_access){
+        long page_id = header.disk_id;
+        latches->lockShared(page_id);
+        nodeHandle current = pinNode(page_id);
+        disk_access++;
+        while (!current->is_leaf){
+            long child_id = current->children[current->findPosition(val)];
+            latches->lockShared(child_id);
+            latches->unlockShared(page_id);
+            page_id = child_id;
+            current = pinNode(page_id);
+            disk_access++;
+        }
+        return current;
+    }
 
     /**
-     * @brief split a node in left and write child, by a left based split
+     * @brief Visit the keys from a position of a latched leaf, the next
+     * leaf is latched before releasing the current one
      *
-     * @param parent_node parent of the node to be splitted
-     * @param pos position of the node to be splitted in the parent node
+     * @param leaf leaf pinned and latched in shared mode, it is released
+     * @param pos first position of the leaf
+     * @param end last key value, nullptr to visit until the last leaf
+     * @param callback function called for each key
+     * @param limit max keys to be visited, -1 without limit
+     * @return long number of keys visited
      */
-    void splitNode (node &parent_node, int pos){
-        node ptr_node = readNode(parent_node.children[pos]);
-        node left_node = createNode(parent_node.children[pos], ptr_node.is_leaf);
-        node right_node = createNode(ptr_node.is_leaf);
-
-        int iter_child;
-        int iter_keys = 0;
-        for (iter_child = 0; iter_keys < ORDER / 2; iter_child++) {
-            left_node.children[iter_child] = ptr_node.children[iter_keys];
-            left_node.keys[iter_child] = ptr_node.keys[iter_keys];
-            left_node.records_id[iter_child] = ptr_node.records_id[iter_keys];
-            left_node.n_keys++;
-            iter_keys++;
+    template<typename Callback>
+    long scanLeaves (nodeHandle &leaf, int pos, const T *end, Callback &callback, long limit){
+        long visited = 0;
+        while (limit < 0 || visited < limit){
+            if (pos == leaf->n_keys){
+                long next = leaf->next_node;
+                if (next == -1)
+                    break;
+                latches->lockShared(next);
+                latches->unlockShared(leaf->disk_id);
+                leaf = pinNode(next);
+                pos = 0;
+                continue;
+            }
+            if (end && leaf->keys [pos] > *end)
+                break;
+            visited++;
+            if (!callback(leaf->keys [pos], leaf->records_id[pos]))
+                break;
+            pos++;
         }
-        left_node.children[iter_child] = ptr_node.children[iter_keys];
+        long leaf_id = leaf->disk_id;
+        leaf.release();
+        latches->unlockShared(leaf_id);
+        return visited;
+    }
 
-        if (ptr_node.is_leaf) { //if the node splitted is leaf
-            left_node.keys[iter_child] = ptr_node.keys[iter_keys]; //left based split
-            left_node.records_id[iter_child] = ptr_node.records_id[iter_keys];
-            left_node.n_keys++;
+    /**
+     * @brief Split n elements in groups of about per_group elements and
+     * at least min_group elements, the elements are distributed evenly so
+     * all the groups have almost the same size. If n is just above a
+     * multiple of per_group there are fewer groups and they are fuller,
+     * a group has at most 2 * min_group elements. There is only one group
+     * if n is less than 2 * min_group, it may be smaller than min_group
+     *
+     * @param n number of elements
+     * @param per_group elements of a group
+     * @param min_group min elements of a group
+     * @return std::vector<long> size of each group
+     */
+    static std::vector<long> evenGroups(long n, long per_group, long min_group){
+        long n_groups = std::max(1L, std::min((n + per_group - 1) / per_group, n / min_group));
+        std::vector<long> sizes;
+        for (long i = 0; i < n_groups; i++)
+            sizes.push_back(n / n_groups + (i < n % n_groups ? 1 : 0));
+        return sizes;
+    }
 
-            //update the next and previous nodes
-            left_node.next_node = right_node.disk_id;
-            left_node.prev_node = ptr_node.prev_node;
-            right_node.prev_node = left_node.disk_id;
-            right_node.next_node = ptr_node.next_node;
+    /**
+     * @brief Minimum number of keys of a node that isn't the root
+     *
+     * @return long
+     */
+    static constexpr long minKeys(){
+        return ORDER / 2 > 0 ? ORDER / 2 : 1;
+    }
 
-            //update the previous node of the next node before split
-            if (right_node.next_node != -1){
-                node temp = readNode(right_node.next_node);
-                temp.prev_node = right_node.disk_id;
-                writeNode(temp.disk_id, temp);
+    /**
+     * @brief Erase a value from a given node, it searches the right child
+     * until reach the leaf, if a child is in underflow it is fixed by
+     * borrowing a key from a sibling or merging it with a sibling
+     *
+     * @param ptr_node node in which erase the value
+     * @param value value to be erased
+     * @param erased set to true if the value was found
+     * @return int state of the node after the deletion
+     */
+    int erase(nodeHandle &ptr_node, const T &value, bool &erased){
+        int pos = ptr_node->findPosition(value);
+
+        if (ptr_node->is_leaf){
+            if (pos < ptr_node->n_keys && !(ptr_node->keys[pos] != value)){
+                ptr_node->removeKeyInPosition(pos);
+                ptr_node.markDirty();
+                erased = true;
             }
-
+        } else {
+            nodeHandle child = pinNode(ptr_node->children[pos]);
+            int state = erase(child, value, erased);
+            if (state == UNDERFLOW)
+                fixUnderflow(ptr_node, pos, child);
         }
-        parent_node.insertKeyInPosition(pos, ptr_node.keys[iter_keys], ptr_node.records_id[iter_keys]); //key promoted
+        return ptr_node->n_keys < minKeys() ? UNDERFLOW : NORMAL;
+    }
 
-        iter_keys++;
+    /**
+     * @brief Fix a child in underflow, it borrows a key from the left or
+     * right sibling if they have keys to spare, else it merges the child
+     * with one of them. The nodes are modified in place
+     *
+     * @param parent_node parent of the child in underflow
+     * @param pos position of the child in the parent node
+     * @param child child in underflow
+     */
+    void fixUnderflow(nodeHandle &parent_node, int pos, nodeHandle &child){
+        if (pos > 0){
+            nodeHandle left = pinNode(parent_node->children[pos - 1]);
+            if (left->n_keys > minKeys()){
+                borrowFromLeft(parent_node, pos, left, child);
+                return;
+            }
+        }
+        if (pos < parent_node->n_keys){
+            nodeHandle right = pinNode(parent_node->children[pos + 1]);
+            if (right->n_keys > minKeys()){
+                borrowFromRight(parent_node, pos, child, right);
+                return;
+            }
+            mergeNodes(parent_node, pos, child, right);
+            return;
+        }
+        nodeHandle left = pinNode(parent_node->children[pos - 1]);
+        mergeNodes(parent_node, pos - 1, left, child);
+    }
 
-        for (iter_child = 0; iter_keys < ORDER + 1; iter_child++) {
-            right_node.children[iter_child] = ptr_node.children[iter_keys];
-            right_node.keys[iter_child] = ptr_node.keys[iter_keys];
-            right_node.records_id[iter_child] = ptr_node.records_id[iter_keys];
-            right_node.n_keys++;
+    /**
+     * @brief Move the last key of the left sibling to the child
+     *
+     * @param parent_node parent of both nodes
+     * @param pos position of the child in the parent node
+     * @param left left sibling
+     * @param child child in underflow
+     */
+    void borrowFromLeft(nodeHandle &parent_node, int pos, nodeHandle &left, nodeHandle &child){
+        long last = left->n_keys - 1;
+        if (child->is_leaf){
+            child->insertKeyInPosition(0, left->keys[last], left->records_id[last]);
+            left->n_keys--;
+            parent_node->keys[pos - 1] = left->keys[last - 1]; //new max key of the left node
+        } else {
+            for (long i = child->n_keys + 1; i > 0; i--)
+                child->children[i] = child->children[i - 1];
+            for (long i = child->n_keys; i > 0; i--)
+                child->keys[i] = child->keys[i - 1];
+            child->keys[0] = parent_node->keys[pos - 1];
+            child->children[0] = left->children[last + 1];
+            child->n_keys++;
+            parent_node->keys[pos - 1] = left->keys[last];
+            left->n_keys--;
+        }
+        left.markDirty();
+        child.markDirty();
+        parent_node.markDirty();
+    }
 
-            iter_keys++;
+    /**
+     * @brief Move the first key of the right sibling to the child
+     *
+     * @param parent_node parent of both nodes
+     * @param pos position of the child in the parent node
+     * @param child child in underflow
+     * @param right right sibling
+     */
+    void borrowFromRight(nodeHandle &parent_node, int pos, nodeHandle &child, nodeHandle &right){
+        if (child->is_leaf){
+            child->keys[child->n_keys] = right->keys[0];
+            child->records_id[child->n_keys] = right->records_id[0];
+            child->n_keys++;
+            right->removeKeyInPosition(0);
+            parent_node->keys[pos] = child->keys[child->n_keys - 1]; //new max key of the child
+        } else {
+            child->keys[child->n_keys] = parent_node->keys[pos];
+            child->children[child->n_keys + 1] = right->children[0];
+            child->n_keys++;
+            parent_node->keys[pos] = right->keys[0];
+            for (long i = 0; i < right->n_keys; i++)
+                right->children[i] = right->children[i + 1];
+            for (long i = 0; i + 1 < right->n_keys; i++)
+                right->keys[i] = right->keys[i + 1];
+            right->n_keys--;
         }
-        right_node.children[iter_child] = ptr_node.children[iter_keys];
-        parent_node.children[pos] = left_node.disk_id;
-        parent_node.children[pos + 1] = right_node.disk_id;
-        parent_node.is_leaf = false; //update the parent to non leaf
+        right.markDirty();
+        child.markDirty();
+        parent_node.markDirty();
+    }
 
+    /**
+     * @brief Merge two siblings in the left one, the right node is freed
+     * and its separator is removed from the parent
+     *
+     * @param parent_node parent of both nodes
+     * @param pos position of the left node in the parent node
+     * @param left left node, it keeps the keys of both nodes
+     * @param right right node, it is freed
+     */
+    void mergeNodes(nodeHandle &parent_node, int pos, nodeHandle &left, nodeHandle &right){
+        if (left->is_leaf){
+            for (long i = 0; i < right->n_keys; i++){
+                left->keys[left->n_keys + i] = right->keys[i];
+                left->records_id[left->n_keys + i] = right->records_id[i];
+            }
+            left->n_keys += right->n_keys;
+            left->next_node = right->next_node;
+            if (right->next_node != -1){ //update the previous node of the next node
+                nodeHandle temp = pinNode(right->next_node);
+                temp->prev_node = left->disk_id;
+                temp.markDirty();
+            }
+        } else {
+            left->keys[left->n_keys] = parent_node->keys[pos]; //the separator goes down
+            for (long i = 0; i < right->n_keys; i++)
+                left->keys[left->n_keys + 1 + i] = right->keys[i];
+            for (long i = 0; i <= right->n_keys; i++)
+                left->children[left->n_keys + 1 + i] = right->children[i];
+            left->n_keys += right->n_keys + 1;
+        }
+        parent_node->removeKeyInPosition(pos);
+        left.markDirty();
+        parent_node.markDirty();
+        long right_id = right->disk_id;
+        right.release();
+        freeNode(right_id);
+    }
 
-        writeNode(parent_node.disk_id, parent_node);
-        writeNode(left_node.disk_id, left_node);
-        writeNode(right_node.disk_id, right_node);
+    /**
+     * @brief If the root is an inner node without keys, its only child
+     * is moved to the root position and freed, so the tree height shrinks
+     *
+     */
+    void shrinkRoot(){
+        nodeHandle root = pinNode(header.disk_id);
+        while (!root->is_leaf && root->n_keys == 0){
+            long child_id = root->children[0];
+            {
+                nodeHandle child = pinNode(child_id);
+                *root = *child; //the only child is moved to the root page
+            }
+            root->disk_id = header.disk_id;
+            if (root->is_leaf){ //it is the only leaf
+                root->next_node = -1;
+                root->prev_node = -1;
+            }
+            root.markDirty();
+            freeNode(child_id);
+        }
     }
 
 public:
@@ -263,43 +575,174 @@ public:
      * @brief Construct a new BPlusTree object by a disk manager object
      * 
      * @param d_manager disk manager to write and read access on file
+     * @param pool_capacity number of nodes cached in memory
      */
-    BPlusTree(diskManager d_manager){
+    BPlusTree(diskManager d_manager, int pool_capacity = BUFFER_POOL_PAGES){
         disk_manager = d_manager;
-
-        if (!disk_manager->is_empty())
-            disk_manager->retrieve_record(0, header);
-        else{  
-            //Init the file with the header info
-            node root (header.disk_id, true);
-            disk_manager->write_record(root.disk_id, root);
-            header.n_nodes++;
-            disk_manager->write_record(0, header);
+        buffer_pool = std::make_shared<BufferPool<node>>(disk_manager, pool_capacity);
+        latches = std::make_shared<PageLatches>();
+        tree_latch = std::make_shared<std::shared_timed_mutex>();
+        bool empty = disk_manager->is_empty();
+        allocator = std::make_shared<PageAllocator<node>>(disk_manager, buffer_pool, header.disk_id);
+
+        if (empty){
+            //Init the file with an empty root
+            createNode(true);
         }
     }
     /**
      * @brief Insert operation of a value, it calls to another insert
      * function to store the value to a specific node and returns is
-     * a overflow occurs, if that true calls to split
+     * a overflow occurs, if that true calls to split. Many insertions
+     * and searches run at once: first the leaf is latched alone and if
+     * it is full the path is latched from the root, releasing the
+     * ancestors of each node that doesn't split
      *
      * @param value
      */
     void insert(const T value, const long record_id = -1){
-        node root = readNode(header.disk_id);
-        int state = insert(root, value, record_id);
+        std::shared_lock<std::shared_timed_mutex> tree(*tree_latch);
+        if (insertOptimistic(value, record_id))
+            return;
+        std::vector<long> held(1, header.disk_id);
+        latches->lockExclusive(header.disk_id);
+        nodeHandle root = pinNode(header.disk_id);
+        int state = insert(root, value, record_id, held);
         if (state == OVERFLOW) {
-            splitRoot();
+            splitRoot(root);
+        }
+        root.release();
+        for (long page_id : held)
+            latches->unlockExclusive(page_id);
+    }
+
+
+    /**
+     * @brief Erase a value from the tree, the nodes in underflow borrow
+     * keys from their siblings or are merged, the freed nodes are reused
+     * by the next insertions and the root shrinks when it has one child.
+     * It waits for the running searches and insertions
+     *
+     * @param value value to be erased
+     * @return true the value was erased
+     * @return false the value doesn't exist
+     */
+    bool erase(const T &value){
+        std::unique_lock<std::shared_timed_mutex> tree(*tree_latch);
+        bool erased = false;
+        {
+            nodeHandle root = pinNode(header.disk_id);
+            erase(root, value, erased);
         }
+        shrinkRoot();
+        return erased;
     }
 
+    /**
+     * @brief Check if the tree has no keys
+     *
+     * @return true the root is an empty leaf
+     * @return false the tree has keys
+     */
+    bool isEmpty(){
+        std::shared_lock<std::shared_timed_mutex> tree(*tree_latch);
+        latches->lockShared(header.disk_id);
+        nodeHandle root = pinNode(header.disk_id);
+        bool empty = root->is_leaf && root->n_keys == 0;
+        root.release();
+        latches->unlockShared(header.disk_id);
+        return empty;
+    }
+
+    /**
+     * @brief Build the tree bottom-up from (key, record_id) pairs sorted by
+     * key. The leaves are written first, then each inner level and finally
+     * the root, so the index file is written in one sequential pass
+     * without descents nor splits. It works only on an empty tree. Every
+     * node but the root gets at least minKeys() keys, so the tree can be
+     * erased like an inserted one
+     *
+     * @tparam Iterator forward iterator of std::pair<T, long>
+     * @param first first pair
+     * @param last end of the pairs
+     * @param fill_factor fraction of ORDER filled in each node, between 0.5 and 1
+     * @return true the tree was built
+     * @return false the tree isn't empty or the keys aren't strictly
+     * increasing, nothing is written
+     */
+    template<typename Iterator>
+    bool bulkLoad(Iterator first, Iterator last, double fill_factor = 1.0){
+        std::unique_lock<std::shared_timed_mutex> tree(*tree_latch);
+        {
+            nodeHandle root = pinNode(header.disk_id);
+            if (!root->is_leaf || root->n_keys > 0)
+                return false;
+        }
+        auto unsorted = std::adjacent_find(first, last, [](const std::pair<T, long> &a, const std::pair<T, long> &b){
+            return !(a.first < b.first);
+        });
+        if (unsorted != last)
+            return false;
+        long n = std::distance(first, last);
+        if (n == 0)
+            return true;
+        if (fill_factor > 1.0) fill_factor = 1.0;
+        if (fill_factor < 0.5) fill_factor = 0.5;
+        long keys_per_leaf = std::max(1L, (long) (ORDER * fill_factor));
+        long children_per_node = std::max(2L, (long) (ORDER * fill_factor) + 1);
+
+        buffer_pool->flushAll();
+        std::vector<long> leaves = evenGroups(n, keys_per_leaf, minKeys());
+        std::vector<std::pair<T, long>> level; //(max key, disk id) of each node of the level
+        long next_id = header.disk_id + 1; //the root keeps its position
+        for (size_t i = 0; i < leaves.size(); i++){
+            bool is_root = leaves.size() == 1;
+            node leaf(is_root ? header.disk_id : next_id++, true); //the nodes are written directly to disk
+            for (long j = 0; j < leaves[i]; j++, ++first){
+                leaf.keys[j] = first->first;
+                leaf.records_id[j] = first->second;
+            }
+            leaf.n_keys = leaves[i];
+            if (!is_root){
+                leaf.prev_node = i > 0 ? leaf.disk_id - 1 : -1;
+                leaf.next_node = i + 1 < leaves.size() ? leaf.disk_id + 1 : -1;
+            }
+            disk_manager->write_record(leaf.disk_id, leaf);
+            level.push_back(std::make_pair(leaf.keys[leaf.n_keys - 1], leaf.disk_id));
+        }
+
+        while (level.size() > 1){
+            bool is_root = (long) level.size() <= ORDER + 1;
+            std::vector<long> groups = is_root ? std::vector<long>(1, level.size())
+                                               : evenGroups(level.size(), children_per_node, minKeys() + 1);
+            std::vector<std::pair<T, long>> upper;
+            size_t child = 0;
+            for (long group : groups){
+                node inner(is_root ? header.disk_id : next_id++, false);
+                for (long j = 0; j < group; j++, child++){
+                    inner.children[j] = level[child].second;
+                    if (j + 1 < group) //the separator is the max key of the left child
+                        inner.keys[j] = level[child].first;
+                }
+                inner.n_keys = group - 1;
+                disk_manager->write_record(inner.disk_id, inner);
+                upper.push_back(std::make_pair(level[child - 1].first, inner.disk_id));
+            }
+            level.swap(upper);
+        }
+
+        allocator->reset(next_id);
+        buffer_pool->reset();
+        return true;
+    }
 
     /**
      * @brief Print the tree values to the console
      * 
      */
     void showTree() {
-        node root = readNode(header.disk_id);
-        showTree(root, 0);
+        nodeHandle root = pinNode(header.disk_id);
+        showTree(*root, 0);
         std::cout << "________________________\n";
     }
 
@@ -311,18 +754,18 @@ public:
     void showTree(node &ptr_node, int tree_level) {
         int i;
         for (i = ptr_node.n_keys - 1; i >= 0; i--) {
-            if (ptr_node.children[i + 1]) { //right child
-                node child = readNode(ptr_node.children[i + 1]);
-                showTree(child, tree_level + 1);
+            if (!ptr_node.is_leaf && ptr_node.children[i + 1]) { //right child
+                nodeHandle child = pinNode(ptr_node.children[i + 1]);
+                showTree(*child, tree_level + 1);
             }
             for (int k = 0; k < tree_level; k++) {
                 std::cout << "    ";
             }
             std::cout << ptr_node.keys[i] << "\n";
         }
-        if (ptr_node.children[i + 1]) {//left child
-            node child = readNode(ptr_node.children[i + 1]);
-            showTree(child, tree_level + 1);
+        if (!ptr_node.is_leaf && ptr_node.children[i + 1]) {//left child
+            nodeHandle child = pinNode(ptr_node.children[i + 1]);
+            showTree(*child, tree_level + 1);
         }
     }
     /**
@@ -331,8 +774,8 @@ public:
     * @param out
     */
     void print(std::ostream& out) {
-        node root = readNode(header.disk_id);
-        print(root, 0, out);
+        nodeHandle root = pinNode(header.disk_id);
+        print(*root, 0, out);
     }
 
     /**
@@ -344,30 +787,35 @@ public:
     void print(node &ptr_node, int tree_level, std::ostream& out) {
         int i;
         for (i = 0; i < ptr_node.n_keys; i++) {
-            if (ptr_node.children[i]) {
-                node child = readNode(ptr_node.children[i]);
-                print(child, tree_level + 1, out);
+            if (!ptr_node.is_leaf && ptr_node.children[i]) {
+                nodeHandle child = pinNode(ptr_node.children[i]);
+                print(*child, tree_level + 1, out);
             }
             if (ptr_node.is_leaf)
                 out << ptr_node.keys[i];
         }
-        if (ptr_node.children[i]) {
-            node child = readNode(ptr_node.children[i]);
-            print(child, tree_level + 1, out);
+        if (!ptr_node.is_leaf && ptr_node.children[i]) {
+            nodeHandle child = pinNode(ptr_node.children[i]);
+            print(*child, tree_level + 1, out);
         }
     }
 
 
     /**
-     * @brief Returns an iterator with the first  leaf node
+     * @brief Returns an iterator with the first  leaf node, the iterators
+     * don't latch the leaves and keep a copy of the current one, so they
+     * aren't used during insertions
      * 
+     * @param read_ahead leaves of the read-ahead window, the next window
+     * is read in the background while the current one is visited
      * @return iterator 
      */
-    iterator begin(){
-        node temp = readNode(header.disk_id);
-        while (!temp.is_leaf)
-            temp = readNode(temp.children[0]);
-        iterator my_iter (disk_manager, temp.disk_id);
+    iterator begin(int read_ahead = 1){
+        nodeHandle temp = pinNode(header.disk_id);
+        while (!temp->is_leaf)
+            temp = pinNode(temp->children[0]);
+        iterator my_iter (buffer_pool, temp->disk_id);
+        my_iter.setReadAhead(read_ahead);
         return my_iter;
     }
 
@@ -377,11 +825,27 @@ public:
      * @return iterator 
      */
     iterator end(){
-        node temp = readNode(header.disk_id);
-        while (!temp.is_leaf){
-            temp = readNode(temp.children[temp.n_keys]);
+        nodeHandle temp = pinNode(header.disk_id);
+        while (!temp->is_leaf){
+            temp = pinNode(temp->children[temp->n_keys]);
         }
-        iterator my_iter (disk_manager, temp.disk_id, temp.n_keys - 1);
+        iterator my_iter (buffer_pool, temp->disk_id, temp->n_keys - 1);
+        return my_iter;
+    }
+
+    /**
+     * @brief Returns an iterator at a key of a leaf, e.g. the leaf and
+     * position given by find. It reads through the buffer pool of the
+     * btree, so it sees the nodes that weren't flushed yet
+     *
+     * @param disk_id disk id of the leaf
+     * @param key_pos position of the key in the leaf
+     * @param read_ahead leaves of the read-ahead window
+     * @return iterator
+     */
+    iterator from(long disk_id, int key_pos = 0, int read_ahead = 1){
+        iterator my_iter (buffer_pool, disk_id, key_pos);
+        my_iter.setReadAhead(read_ahead);
         return my_iter;
     }
 
@@ -391,10 +855,29 @@ public:
      * @return iterator 
      */
     iterator null(){
-        iterator my_iter (disk_manager, -1);
+        iterator my_iter (buffer_pool, -1);
         return my_iter;
     }
 
+    /**
+     * @brief Write back to disk the nodes modified in the buffer pool
+     *
+     */
+    void flush(){
+        if (buffer_pool)
+            buffer_pool->flushAll();
+    }
+
+    /**
+     * @brief Get the buffer pool of the index file, it is used to
+     * check the physical disk accesses
+     *
+     * @return bufferPool
+     */
+    bufferPool getBufferPool(){
+        return buffer_pool;
+    }
+
     ~BPlusTree(){
     }
 
@@ -406,9 +889,9 @@ public:
      * @return false the value doesn't exist
      */
     bool isKeyPresent(const T &val){
-        node root = readNode(header.disk_id);
         int key_pos = -1;
-        long key_disk_id = findKey(root, val, key_pos);
+        long key_disk_id;
+        find(val, key_disk_id, key_pos);
         if (key_disk_id == -1)
             return false;
         else
@@ -423,16 +906,14 @@ public:
      * @return long id of the record finded by key value, if not exist return -1
      */
     long getRecordIdByKeyValue(const T &val, int &disk_access){
-        node root = readNode(header.disk_id);
-        disk_access++;
-        int key_pos = -1;
-        long key_disk_id = findKey(root, val, key_pos, disk_access);
-        if (key_disk_id != -1){
-            node key_node = readNode(key_disk_id);
-            disk_access++;
-            return key_node.records_id[key_pos];
-        }
-        return key_disk_id; //return -1
+        std::shared_lock<std::shared_timed_mutex> tree(*tree_latch);
+        nodeHandle leaf = findLeaf(val, disk_access);
+        int pos = leaf->findPosition(val);
+        long record_id = (pos == leaf->n_keys || leaf->keys[pos] != val) ? -1 : leaf->records_id[pos];
+        long leaf_id = leaf->disk_id;
+        leaf.release();
+        latches->unlockShared(leaf_id); //the leaf is read in place while it is latched
+        return record_id;
     }
 
     /**
@@ -443,8 +924,13 @@ public:
      * @param key_pos position in the keys array
      */
     void find(const T &val, long &record_id ,int &key_pos){
-        node root = readNode(header.disk_id);
-        record_id = findKey(root, val, key_pos);
+        std::shared_lock<std::shared_timed_mutex> tree(*tree_latch);
+        int disk_access = 0;
+        nodeHandle leaf = findLeaf(val, disk_access);
+        record_id = findKey(*leaf, val, key_pos);
+        long leaf_id = leaf->disk_id;
+        leaf.release();
+        latches->unlockShared(leaf_id);
     }
 
     /**
@@ -457,17 +943,15 @@ public:
      * @return long position of the record on disk
      */
     long findKey (node &ptr, const T &val, int &key_pos, int &disk_access){
-        int pos = 0;
-        while (pos < ptr.n_keys && ptr.keys[pos] < val)
-            pos++;
+        int pos = ptr.findPosition(val);
 
         if (!ptr.is_leaf){
             long page_id = ptr.children [pos];
-            node child = readNode (page_id);
+            nodeHandle child = pinNode (page_id);
             disk_access++;
-            return findKey(child, val, key_pos, disk_access);
+            return findKey(*child, val, key_pos, disk_access);
         } else {
-            if (ptr.keys [pos] != val)
+            if (pos == ptr.n_keys || ptr.keys [pos] != val)
                 return -1;
             else {
                 key_pos = pos;
@@ -487,16 +971,14 @@ public:
      * @return long position on disk
      */
     long findKey (node &ptr, const T &val, int &key_pos){
-        int pos = 0;
-        while (pos < ptr.n_keys && ptr.keys[pos] < val)
-            pos++;
+        int pos = ptr.findPosition(val);
 
         if (!ptr.is_leaf){
             long page_id = ptr.children [pos];
-            node child = readNode (page_id);
-            return findKey(child, val, key_pos);
+            nodeHandle child = pinNode (page_id);
+            return findKey(*child, val, key_pos);
         } else {
-            if (ptr.keys [pos] != val)
+            if (pos == ptr.n_keys || ptr.keys [pos] != val)
                 return -1;
             else {
                 key_pos = pos;
@@ -512,8 +994,13 @@ public:
      * @param val
      */
     void search (const T &val) {
-        node root = readNode(header.disk_id);
-        int res = search (root, val);
+        std::shared_lock<std::shared_timed_mutex> tree(*tree_latch);
+        int disk_access = 0;
+        nodeHandle leaf = findLeaf(val, disk_access);
+        int res = search (*leaf, val);
+        long leaf_id = leaf->disk_id;
+        leaf.release();
+        latches->unlockShared(leaf_id);
         if (res == -1)
             std::cout << "Not found\n";
         else
@@ -529,79 +1016,88 @@ public:
      * @return int
      */
     int search (node &ptr, const T &val){
-        int pos = 0;
-        while (pos < ptr.n_keys && ptr.keys[pos] < val)
-            pos++;
+        int pos = ptr.findPosition(val);
 
         if (!ptr.is_leaf){
             long page_id = ptr.children [pos];
-            node child = readNode (page_id);
-            return search (child, val);
+            nodeHandle child = pinNode (page_id);
+            return search (*child, val);
         } else {
-            if (ptr.keys [pos] != val){
+            if (pos == ptr.n_keys || ptr.keys [pos] != val){
                 return -1;
             }else {
-                long page_record = ptr.children [pos];
-                return page_record;
+                return ptr.disk_id;
             }
         }
 
     }
 
     /**
-     * @brief
+     * @brief Stream the keys in [first, end] and their records to a
+     * callback, the leaves are walked from left to right latching the
+     * next leaf before releasing the current one, so the memory used
+     * doesn't depend on the size of the result. The callback is called
+     * with a latched leaf, it must not modify the tree
      *
-     * @param first
-     * @param end
-     * @return std::vector<long>
+     * @tparam Callback callable as bool(const T &key, long record_id),
+     * it returns false to stop the scan
+     * @param first first key value
+     * @param end last key value
+     * @param callback function called for each key
+     * @param limit max keys to be visited, -1 without limit
+     * @return long number of keys visited
      */
-    std::vector<long> range_search (const T &first, const T &end){
-        node root = readNode(header.disk_id);
-        std::vector <long> res;
-        range_search (root, first, end, res);
-        return res;
+    template<typename Callback>
+    long range_scan (const T &first, const T &end, Callback callback, long limit = -1){
+        std::shared_lock<std::shared_timed_mutex> tree(*tree_latch);
+        int disk_access = 0;
+        nodeHandle leaf = findLeaf(first, disk_access);
+        int pos = leaf->findPosition(first);
+        return scanLeaves(leaf, pos, &end, callback, limit);
     }
 
-
     /**
-     * @brief
+     * @brief Stream every key of the tree in order with its record, like
+     * range_scan without bounds
      *
-     * @param ptr
-     * @param first
-     * @param second
-     * @param res
+     * @tparam Callback callable as bool(const T &key, long record_id),
+     * it returns false to stop the scan
+     * @param callback function called for each key
+     * @param limit max keys to be visited, -1 without limit
+     * @return long number of keys visited
      */
-    void range_search (node &ptr, const T &first, const T &second, std::vector <long> &res){
-        int pos = 0;
-        while (pos < ptr.n_keys && ptr.keys[pos] < first)
-            pos++;
-
-        if (!ptr.is_leaf){
-            long page_id = ptr.children [pos];
-            node child = readNode (page_id);
-            range_search (child, first, second, res);
-        } else {
-            if (ptr.keys [pos] >= first){
-                std::cout << ptr.keys [pos] << "." << ptr.disk_id << " - ";
-                //res.push_back (ptr.children [pos]);
-                res.push_back (ptr.records_id[pos]);
-            }
-            pos++;
-            node temp = ptr;
-            while (temp.keys [pos] <= second && pos < temp.n_keys){
-                std::cout << temp.keys [pos] << "." << temp.disk_id << " - ";
-                //res.push_back (temp.children [pos]);
-                res.push_back (temp.records_id[pos]);
-                pos++;
-                if (pos == temp.n_keys ){
-                    temp = readNode (temp.next_node);
-                    pos = 0;
-                }
-            }
+    template<typename Callback>
+    long scan (Callback callback, long limit = -1){
+        std::shared_lock<std::shared_timed_mutex> tree(*tree_latch);
+        long page_id = header.disk_id;
+        latches->lockShared(page_id);
+        nodeHandle leaf = pinNode(page_id);
+        while (!leaf->is_leaf){
+            long child_id = leaf->children[0];
+            latches->lockShared(child_id);
+            latches->unlockShared(page_id);
+            page_id = child_id;
+            leaf = pinNode(page_id);
         }
+        return scanLeaves(leaf, 0, nullptr, callback, limit);
     }
 
-
+    /**
+     * @brief Search the records of the keys in [first, end]
+     *
+     * @param first first key value
+     * @param end last key value
+     * @param limit max records to be returned, -1 without limit
+     * @return std::vector<long> positions of the records
+     */
+    std::vector<long> range_search (const T &first, const T &end, long limit = -1){
+        std::vector <long> res;
+        range_scan(first, end, [&res](const T &, long record_id){
+            res.push_back (record_id);
+            return true;
+        }, limit);
+        return res;
+    }
 
 };
 
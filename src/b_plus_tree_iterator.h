@@ -3,17 +3,23 @@
  * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
  * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
  * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
- * @brief B+Tree Iterators Implementation, operators ++, --, dereference * were implented
+ * @brief B+Tree Iterators Implementation, operators ++, --, dereference * were implented.
+ * The iterator keeps its current leaf in memory, so a node is read only
+ * when the iterator crosses to the next or previous leaf. With a read-ahead
+ * window the next leaves are read by a background task while the current
+ * ones are visited
  * @version 0.1
  * @date 2020-05-12
  * @copyright Copyright (c) 2020
  * 
  */
 #include "disk_manager.h"
+#include "buffer_pool.h"
 #include <memory>
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <future>
 #pragma once
 
 namespace bd2{
@@ -31,49 +37,110 @@ namespace bd2{
 
         using node = bd2::Node<T, ORDER>;
         using diskManager = std::shared_ptr<DiskManager>;
+        using bufferPool = std::shared_ptr<BufferPool<node>>;
         
+        using nodePtr = std::shared_ptr<const node>;
+
         long node_disk_id; //node id on disk
         int keys_pos; //iterator for keys elements
         
-        diskManager disk_manager;
+        bufferPool buffer_pool;
+
+        nodePtr leaf; //cached leaf, it is shared by the copies of the iterator
+        std::vector<nodePtr> ahead; //leaves after the cached one, read in advance
+        size_t ahead_pos = 0; //next leaf of the window to be used
+        std::shared_future<std::vector<nodePtr>> next_window; //window after ahead, it is being read in the background
+        int read_ahead = 1; //leaves of a window
 
         /**
          * @brief Read a node from disk by a given disk id position
          * 
          * @param disk_id position on disk to be read
-         * @return node node with the read values 
+         * @return nodePtr node with the read values 
          */
-        node readNode(long disk_id){
-            node new_node(-1);
-            disk_manager->retrieve_record(disk_id, new_node);
+        nodePtr readNode(long disk_id){
+            return readNode(buffer_pool, disk_id);
+        }
+
+        static nodePtr readNode(const bufferPool &pool, long disk_id){
+            std::shared_ptr<node> new_node = std::make_shared<node>(-1);
+            pool->read(disk_id, *new_node);
             return new_node;
         }
 
-    public:
+        /**
+         * @brief Read a window of leaves following their links, it runs
+         * in the background task of the iterator
+         *
+         * @param pool buffer pool of the btree
+         * @param disk_id first leaf of the window
+         * @param n leaves of the window
+         * @return std::vector<nodePtr> leaves read, fewer than n at the last leaf
+         */
+        static std::vector<nodePtr> readWindow(bufferPool pool, long disk_id, int n){
+            std::vector<nodePtr> window;
+            for (int i = 0; i < n && disk_id != -1; i++){
+                window.push_back(readNode(pool, disk_id));
+                disk_id = window.back()->next_node;
+            }
+            return window;
+        }
 
-        friend class BPlusTree<T, ORDER>;
+        /**
+         * @brief Move to the window that starts by the leaf disk_id: it is
+         * taken from the background task if it was read there, else it is
+         * read now. The window after it is requested to the background
+         * task, so it is read while the leaves of this one are visited
+         *
+         * @param disk_id first leaf of the window
+         */
+        void readAhead(long disk_id){
+            std::vector<nodePtr> window;
+            if (next_window.valid()){
+                window = next_window.get();
+                next_window = std::shared_future<std::vector<nodePtr>>();
+            }
+            if (window.empty() || window.front()->disk_id != disk_id)
+                window = readWindow(buffer_pool, disk_id, read_ahead);
+            ahead.swap(window);
+            ahead_pos = 0;
+            if (!ahead.empty() && ahead.back()->next_node != -1)
+                next_window = std::async(std::launch::async, &BPlusTreeIterator::readWindow,
+                                         buffer_pool, ahead.back()->next_node, read_ahead).share();
+        }
 
         /**
-         * @brief Construct a new BPlusTreeIterator object
-         * 
-         * @param manager disk manager of the btree
-         * @param ndi disk id of the node
+         * @brief Leaf of node_disk_id, it is read only if it isn't the
+         * cached leaf or the next leaf of the window
+         *
+         * @return const node& 
          */
-        BPlusTreeIterator(diskManager &manager, long ndi){
-            disk_manager = manager;
-            node_disk_id = ndi;
-            keys_pos = 0;
+        const node& current(){
+            if (leaf && leaf->disk_id == node_disk_id)
+                return *leaf;
+            if (ahead_pos < ahead.size() && ahead[ahead_pos]->disk_id == node_disk_id){
+                leaf = ahead[ahead_pos++];
+                return *leaf;
+            }
+            ahead.clear();
+            ahead_pos = 0;
+            leaf = readNode(node_disk_id);
+            return *leaf;
         }
 
+    public:
+
+        friend class BPlusTree<T, ORDER>;
+
         /**
          * @brief Construct a new BPlusTreeIterator object
          * 
-         * @param manager disk manager of the btree
+         * @param pool buffer pool of the btree
          * @param ndi disk id of the node
          * @param _keys_pos position on key to start the iterator
          */
-        BPlusTreeIterator(diskManager &manager, long ndi, int _keys_pos){
-            disk_manager = manager;
+        BPlusTreeIterator(const bufferPool &pool, long ndi, int _keys_pos = 0){
+            buffer_pool = pool;
             node_disk_id = ndi;
             keys_pos = _keys_pos;
         }
@@ -85,8 +152,25 @@ namespace bd2{
          */
         BPlusTreeIterator(const BPlusTreeIterator & bpti){
             node_disk_id = bpti.node_disk_id;
-            disk_manager = bpti.disk_manager;
+            buffer_pool = bpti.buffer_pool;
             keys_pos = bpti.keys_pos;
+            leaf = bpti.leaf;
+            ahead = bpti.ahead;
+            ahead_pos = bpti.ahead_pos;
+            next_window = bpti.next_window;
+            read_ahead = bpti.read_ahead;
+        }
+
+        /**
+         * @brief Set the read-ahead window, the leaves are visited in windows
+         * and the next window is read by a background task while the
+         * current one is visited, so an ordered scan reads each leaf once
+         * and doesn't wait for the reads of the following leaves
+         *
+         * @param leaves leaves of the window, 1 reads one leaf at a time
+         */
+        void setReadAhead(int leaves){
+            read_ahead = leaves > 1 ? leaves : 1;
         }
 
         /**
@@ -98,10 +182,13 @@ namespace bd2{
          */
         BPlusTreeIterator& operator++(){
             keys_pos++;
-            node temp = readNode(node_disk_id);
+            const node &temp = current();
             if (keys_pos >= temp.n_keys){    //if we reach the end of the keys, go to the next node
                 node_disk_id = temp.next_node;
                 keys_pos = 0;
+                bool in_window = ahead_pos < ahead.size() && ahead[ahead_pos]->disk_id == node_disk_id;
+                if (read_ahead > 1 && node_disk_id != -1 && !in_window)
+                    readAhead(node_disk_id);
             }
             return *this;
         }
@@ -128,12 +215,10 @@ namespace bd2{
          */
         BPlusTreeIterator& operator--(){
             keys_pos--;
-            node temp = readNode(node_disk_id);
             if (keys_pos < 0){    //if we reach the end of the keys, go to the next node
-                node_disk_id = temp.prev_node;
+                node_disk_id = current().prev_node;
                 if (node_disk_id != -1){
-                    node prev = readNode(node_disk_id);
-                    keys_pos = prev.n_keys -1;
+                    keys_pos = current().n_keys -1;
                 }else{
                     keys_pos = 0;
                 }
@@ -164,7 +249,13 @@ namespace bd2{
         BPlusTreeIterator& operator=(const BPlusTreeIterator& bpti){
             keys_pos = bpti.keys_pos;
             node_disk_id = bpti.node_disk_id;
-            disk_manager = bpti.disk_manager;
+            buffer_pool = bpti.buffer_pool;
+            leaf = bpti.leaf;
+            ahead = bpti.ahead;
+            ahead_pos = bpti.ahead_pos;
+            next_window = bpti.next_window;
+            read_ahead = bpti.read_ahead;
+            return *this;
         }
 
         /**
@@ -198,13 +289,16 @@ namespace bd2{
          * @return T key value
          */
         T operator*(){
-            node temp = readNode(node_disk_id);
-            return temp.keys[keys_pos];
+            return current().keys[keys_pos];
         }
 
+        /**
+         * @brief Id of the record of the key in the current keys_pos position
+         *
+         * @return long position of the record on disk
+         */
         long getRecordId(){
-            node temp = readNode(node_disk_id);
-            return temp.records_id[keys_pos];
+            return current().records_id[keys_pos];
         }
 
     };
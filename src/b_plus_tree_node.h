@@ -1,4 +1,10 @@
 #pragma once
+#include "node_search.h"
+#include <cstddef>
+#include <cstring>
+
+#define NODE_PAGE_SIZE 4096 //nodes are padded to a multiple of this size
+
 namespace bd2{
 
     template <class T, int ORDER>
@@ -7,35 +13,158 @@ namespace bd2{
     template <class T, int ORDER>
     class BPlusTreeIterator;
 
+    template<class T, std::size_t PAGE_SIZE>
+    struct PageOrder;
+
+    /**
+     * @brief On-disk layout of a node: the fixed size fields first and then
+     * the arrays. It has no constructors so its size has no tail reuse.
+     * An inner node only needs the pages of its children and a leaf only
+     * needs the records of its keys, so both share the same array. A key
+     * costs sizeof(T) + sizeof(long) bytes in both kinds of node, so they
+     * also share the order: a 4 KiB page takes 252 long keys instead of
+     * the 167 of a layout with both arrays, about 1.5 times, not twice
+     *
+     * @tparam T type of the key value
+     * @tparam ORDER order of the btree
+     */
     template<class T, int ORDER>
-    class Node{
+    class NodeLayout{
+        static_assert(KeyTraits<T>::size == sizeof(T), "NodeLayout: the keys are stored on the page as T");
+    protected:
+        long n_keys;
+        long next_node; //link to the next node if is a leaf
+        long prev_node; //link to the previous node if is a leaf
+        long disk_id; //id of the index on disk
+        bool is_leaf;
 
         T keys [ORDER + 1];
-        long children [ORDER + 2];
-        long records_id[ORDER + 1]; //id of the record on disk
+        union{
+            long children [ORDER + 2]; //pages of the children, only in inner nodes
+            long records_id [ORDER + 2]; //id of the record on disk, only in leaves
+        };
+
+        template<class, std::size_t>
+        friend struct PageOrder;
+    };
+
+    /**
+     * @brief Bytes needed to complete the last page of a layout
+     *
+     * @tparam SIZE size of the layout
+     */
+    template<std::size_t SIZE>
+    struct PagePadding{
+        static constexpr std::size_t value = (NODE_PAGE_SIZE - SIZE % NODE_PAGE_SIZE) % NODE_PAGE_SIZE;
+    };
+
+    /**
+     * @brief Layout padded to a multiple of NODE_PAGE_SIZE, so the node n
+     * starts on disk at the aligned offset n * sizeof(node)
+     */
+    template<class Layout, std::size_t PADDING>
+    class PaddedLayout : public Layout{
+        char padding[PADDING];
+    };
+
+    template<class Layout>
+    class PaddedLayout<Layout, 0> : public Layout{
+    };
+
+    /**
+     * @brief Largest order not greater than ORDER whose layout fits in a
+     * page, it steps down over the alignment padding of the estimate
+     *
+     * @tparam T type of the key value
+     * @tparam PAGE_SIZE size of the page on disk
+     * @tparam ORDER first order to be checked
+     */
+    template<class T, std::size_t PAGE_SIZE, int ORDER, bool FITS = (sizeof(NodeLayout<T, ORDER>) <= PAGE_SIZE)>
+    struct FittingOrder{
+        static constexpr int value = ORDER;
+    };
+
+    template<class T, std::size_t PAGE_SIZE, int ORDER>
+    struct FittingOrder<T, PAGE_SIZE, ORDER, false>{
+        static constexpr int value = FittingOrder<T, PAGE_SIZE, ORDER - 1>::value;
+    };
+
+    /**
+     * @brief Largest order whose node fits in a page of PAGE_SIZE bytes
+     * (4 KiB, 8 KiB, 16 KiB, ...). The fixed fields take the bytes before
+     * the keys and each order adds a key and a child, the node has one
+     * more key and two more children than its order
+     *
+     * @tparam T type of the key value
+     * @tparam PAGE_SIZE size of the page on disk
+     */
+    template<class T, std::size_t PAGE_SIZE>
+    struct PageOrder{
+    private:
+        using sample = NodeLayout<T, 1>;
+        static constexpr std::size_t header = offsetof(sample, keys); //fixed fields and their padding
+        static constexpr std::size_t key_size = KeyTraits<T>::size;
+        static constexpr std::size_t extra = key_size + 2 * sizeof(long); //the extra key and children
+        static constexpr std::size_t entry = key_size + sizeof(long);
+        static_assert(PAGE_SIZE >= header + extra + 2 * entry, "PageOrder: the page is too small for the key type");
+    public:
+        static constexpr int value = FittingOrder<T, PAGE_SIZE, (int) ((PAGE_SIZE - header - extra) / entry)>::value;
+        static_assert(value >= 2, "PageOrder: the page is too small for the key type");
+    };
+
+    template<class T, std::size_t PAGE_SIZE, int ORDER, bool FITS>
+    constexpr int FittingOrder<T, PAGE_SIZE, ORDER, FITS>::value;
 
-        long n_keys = 0;
-        bool is_leaf = false;
+    template<class T, std::size_t PAGE_SIZE, int ORDER>
+    constexpr int FittingOrder<T, PAGE_SIZE, ORDER, false>::value;
 
-        long next_node  = -1; //link to the next node if is a leaf
-        long prev_node = -1; //link to the previous node if is a leaf
-        long disk_id = -1; //id of the index on disk
+    template<class T, std::size_t PAGE_SIZE>
+    constexpr int PageOrder<T, PAGE_SIZE>::value;
+
+    template<class T, int ORDER>
+    class Node : public PaddedLayout<NodeLayout<T, ORDER>, PagePadding<sizeof(NodeLayout<T, ORDER>)>::value>{
 
-        void initChildrensWithZeros(){
-            for (int i = 0; i < ORDER + 2; i++)
-                children[i] = 0;
+        using layout = NodeLayout<T, ORDER>;
+        using layout::n_keys;
+        using layout::next_node;
+        using layout::prev_node;
+        using layout::disk_id;
+        using layout::is_leaf;
+        using layout::keys;
+        using layout::children;
+        using layout::records_id;
+
+        /**
+         * @brief Set the default values of the fixed size fields, the
+         * whole page is zeroed first so its padding isn't written to disk
+         * with garbage
+         *
+         * @param d_id id of the node on disk
+         * @param is_leaf_flag if the node is a leaf
+         */
+        void init(long d_id, bool is_leaf_flag){
+            std::memset(static_cast<void *>(this), 0, sizeof(Node));
+            n_keys = 0;
+            next_node = -1;
+            prev_node = -1;
+            disk_id = d_id;
+            is_leaf = is_leaf_flag;
         }
     public:
 
+        /**
+         * @brief Construct an empty Node object, it is used to store pages
+         * in the buffer pool before reading them
+         */
+        Node(): Node(-1){};
+
         /**
          * @brief Construct a new Node object
           *
          * @param d_id diskManager id of the node on disk
          */
         Node(long d_id){
-            disk_id = d_id;
-            initChildrensWithZeros();
-
+            init(d_id, false);
         };
 
         /**
@@ -45,31 +174,94 @@ namespace bd2{
          * @param is_leaf
          */
         Node(long d_id, bool is_leaf_flag){
-            disk_id = d_id;
-            is_leaf = is_leaf_flag;
-            initChildrensWithZeros();
+            init(d_id, is_leaf_flag);
         };
 
         /**
          * @brief Function to insert a key_value value in a given position
+         * of a leaf
          *
          * @param key_value
          * @param pos
+         * @param record_id id of the record on disk
          */
         void insertKeyInPosition(int pos, const T &key_value, const long record_id){
             //Move to the right until we find the pos of the key_value value
             for(int i = n_keys; i > pos; i--){
                 keys[i] = keys[i - 1];
                 records_id[i] = records_id[i - 1];
-                children[i + 1] = children[i];
             }
             keys[pos] = key_value;
             records_id[pos] = record_id;
+            n_keys += 1;
+
+        };
+
+        /**
+         * @brief Function to insert a separator in a given position of an
+         * inner node, the child at its left is duplicated at its right
+         *
+         * @param pos position of the separator
+         * @param key_value separator
+         */
+        void insertSeparatorInPosition(int pos, const T &key_value){
+            for(int i = n_keys; i > pos; i--){
+                keys[i] = keys[i - 1];
+                children[i + 1] = children[i];
+            }
+            keys[pos] = key_value;
             children[pos + 1] = children [pos];
             n_keys += 1;
+        };
 
+        /**
+         * @brief Function to remove the key in a given position, with its
+         * record if it is a leaf or with the child at its right if it is
+         * an inner node
+         *
+         * @param pos position of the key
+         */
+        void removeKeyInPosition(int pos){
+            for(int i = pos; i < n_keys - 1; i++){
+                keys[i] = keys[i + 1];
+                if (is_leaf)
+                    records_id[i] = records_id[i + 1];
+                else
+                    children[i + 1] = children[i + 2];
+            }
+            n_keys -= 1;
         };
 
+        /**
+         * @brief Find the position of the first key not less than a value,
+         * the search routine is chosen at compile time by T and ORDER
+         *
+         * @param key_value value to be searched
+         * @return int position in the keys array (n_keys if all are less)
+         */
+        int findPosition(const T &key_value) const{
+            return NodeSearch<T, ORDER>::lowerBound(keys, (int) n_keys, key_value);
+        }
+
+        /**
+         * @brief Next node of the free list, if the node was released
+         *
+         * @return long
+         */
+        long nextFreePage() const{
+            return next_node;
+        }
+
+        /**
+         * @brief Link a released node to the free list
+         *
+         * @param next next node of the free list
+         */
+        void linkFreePage(long next){
+            n_keys = 0;
+            next_node = next;
+        }
+
         /**
          * @brief Check is the node is in overflow
          *
@@ -0,0 +1,125 @@
+/**
+ * @file block_reader.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Block Reader Implementation, it streams the records of a file in
+ * large chunks with double buffering: the next chunk is read by a
+ * background task while the current one is used
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include <string>
+#include <fstream>
+#include <future>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#define BLOCK_READER_CHUNK (4L * 1024 * 1024) //bytes read by one I/O of the block reader
+
+namespace bd2{
+
+/**
+ * @brief Reader of the records [begin, end) of a file, the records are
+ * read into the chunk without being copied again
+ *
+ * @tparam Record class stored in the file
+ */
+template<typename Record>
+class BlockReader{
+
+    std::ifstream file;
+    long next_record; //first record of the chunk that will be prefetched
+    long end_record;
+    long chunk_records; //records of each chunk
+    std::vector<Record> buffers[2];
+    int filling = 0; //buffer of the chunk being prefetched
+    std::future<long> prefetch; //records read into the other buffer
+
+    /**
+     * @brief Read the next chunk into a buffer
+     *
+     * @param buffer buffer of the chunk
+     * @return long number of complete records read
+     */
+    long readChunk(int buffer){
+        long count = std::min(chunk_records, end_record - next_record);
+        if (count <= 0)
+            return 0;
+        file.read((char *) buffers[buffer].data(), count * sizeof(Record));
+        count = file.gcount() / (long) sizeof(Record);
+        next_record += count;
+        if (count == 0)
+            end_record = next_record; //the file is shorter than expected
+        return count;
+    }
+
+    /**
+     * @brief Start the read of the next chunk in background
+     *
+     * @param buffer buffer of the chunk
+     */
+    void startPrefetch(int buffer){
+        prefetch = std::async(std::launch::async, &BlockReader::readChunk, this, buffer);
+    }
+
+public:
+
+    /**
+     * @brief Construct a new Block Reader object
+     *
+     * @param filename filename of the data
+     * @param begin first record to be read
+     * @param end end of the records to be read, -1 reads until the end of the file
+     * @param chunk_bytes bytes of each chunk, it is rounded to whole records
+     */
+    BlockReader(const std::string &filename, long begin = 0, long end = -1, long chunk_bytes = BLOCK_READER_CHUNK){
+        file.open(filename, std::ios::in | std::ios::binary);
+        next_record = begin;
+        end_record = end < 0 ? std::numeric_limits<long>::max() : end;
+        chunk_records = std::max(1L, std::min(chunk_bytes / (long) sizeof(Record), end_record - begin));
+        if (!file){
+            end_record = begin;
+            return;
+        }
+        file.seekg(begin * (long) sizeof(Record), std::ios::beg);
+        buffers[0].resize(chunk_records);
+        buffers[1].resize(chunk_records);
+        startPrefetch(0);
+    }
+
+    BlockReader(const BlockReader &) = delete;
+    BlockReader& operator=(const BlockReader &) = delete;
+
+    ~BlockReader(){
+        if (prefetch.valid())
+            prefetch.wait();
+    }
+
+    /**
+     * @brief Get the next chunk, the records are valid until the next call
+     *
+     * @param records first record of the chunk
+     * @param count number of records of the chunk
+     * @return true there is a chunk
+     * @return false the records were read
+     */
+    bool next(const Record *&records, long &count){
+        if (!prefetch.valid())
+            return false;
+        count = prefetch.get();
+        if (count == 0)
+            return false;
+        int ready = filling;
+        filling = 1 - filling;
+        if (next_record < end_record)
+            startPrefetch(filling); //the other buffer is read while this chunk is used
+        records = buffers[ready].data();
+        return true;
+    }
+};
+}
@@ -0,0 +1,466 @@
+/**
+ * @file buffer_pool.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Buffer Pool Implementation, it keeps a fixed number of pages of
+ * a disk file in memory with pin/unpin semantics, dirty tracking with
+ * write-back and LRU-K replacement. PageHandle keeps a page pinned while
+ * it is used in place
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include "disk_manager.h"
+#include <memory>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <limits>
+#include <mutex>
+
+#define BUFFER_POOL_PAGES 64
+
+namespace bd2{
+
+/**
+ * @brief Page cache between the index structures and the DiskManager
+ *
+ * @tparam Page type of the page stored in the file (Node, Bucket, ...)
+ */
+template<typename Page>
+class BufferPool{
+
+    using diskManager = std::shared_ptr<DiskManager>;
+
+    struct Frame{
+        Page page;
+        long page_id = -1;
+        int pin_count = 0;
+        bool dirty = false;
+        std::deque<long> history; //last K access times, the most recent at the front
+    };
+
+    diskManager disk_manager;
+    std::deque<Frame> frames; //a deque, so the pinned pages don't move when it grows
+    std::unordered_map<long, int> page_table; //page id -> frame position
+    std::unordered_map<long, std::deque<long>> retained; //history of the replaced pages
+    std::deque<long> retained_order; //replaced pages, the oldest at the front
+    int k; //K of the LRU-K policy
+    long current_time = 0; //logical clock for the access history
+    long n_pages; //pages on the file, including the not flushed ones
+
+    long n_reads = 0; //physical reads
+    long n_writes = 0; //physical writes
+
+    std::mutex latch; //protects the frames and the page table, the pool is shared by threads
+
+    /**
+     * @brief Register an access to a frame in its history. Consecutive
+     * accesses to the same page are correlated (e.g. a node read twice
+     * by the same search), so they count as one access
+     *
+     * @param frame frame accessed
+     */
+    void touch(Frame &frame){
+        current_time++;
+        if (!frame.history.empty() && frame.history.front() == current_time - 1){
+            frame.history.front() = current_time;
+            return;
+        }
+        frame.history.push_front(current_time);
+        if ((int) frame.history.size() > k)
+            frame.history.pop_back();
+    }
+
+    /**
+     * @brief Choose the frame to be replaced, an empty frame if exist,
+     * else the unpinned frame with the largest backward K-distance.
+     * Frames with less than K accesses have infinite distance and
+     * between them the least recently used is chosen
+     *
+     * @return int position of the frame, -1 if all the frames are pinned
+     */
+    int victim(){
+        int best = -1;
+        bool best_infinite = false;
+        long best_time = std::numeric_limits<long>::max();
+        for (int i = 0; i < (int) frames.size(); i++){
+            Frame &frame = frames[i];
+            if (frame.page_id == -1)
+                return i;
+            if (frame.pin_count > 0)
+                continue;
+            bool infinite = (int) frame.history.size() < k;
+            long time = infinite ? frame.history.front() : frame.history.back();
+            if ((infinite && !best_infinite) || (infinite == best_infinite && time < best_time)){
+                best = i;
+                best_infinite = infinite;
+                best_time = time;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Keep the access history of a replaced page, so a page that is
+     * referenced again recovers its K-distance instead of being the next
+     * victim. Only the history of the last replaced pages is kept
+     *
+     * @param frame frame to be replaced
+     */
+    void retain(Frame &frame){
+        retained[frame.page_id] = frame.history;
+        retained_order.push_back(frame.page_id);
+        while (retained_order.size() > 4 * frames.size()){
+            long page_id = retained_order.front();
+            retained_order.pop_front();
+            auto history = retained.find(page_id);
+            if (history != retained.end() && !page_table.count(page_id))
+                retained.erase(history);
+        }
+    }
+
+    /**
+     * @brief Write back a frame if it is dirty
+     *
+     * @param frame frame to be written
+     */
+    void writeBack(Frame &frame){
+        if (frame.dirty){
+            disk_manager->write_record(frame.page_id, frame.page);
+            frame.dirty = false;
+            n_writes++;
+        }
+    }
+
+    /**
+     * @brief Get a frame for a page, replacing another page if is necessary
+     *
+     * @param page_id page to be loaded in the frame
+     * @param read_page if the page has to be read from disk
+     * @return Frame& frame with the page
+     */
+    Frame& fetch(long page_id, bool read_page){
+        auto found = page_table.find(page_id);
+        if (found != page_table.end())
+            return frames[found->second];
+
+        int pos = victim();
+        if (pos == -1){ //all the frames are pinned, e.g. by the paths of many threads
+            frames.emplace_back();
+            pos = (int) frames.size() - 1;
+        }
+
+        Frame &frame = frames[pos];
+        if (frame.page_id != -1){
+            writeBack(frame);
+            page_table.erase(frame.page_id);
+            retain(frame);
+        }
+        bool read = read_page && page_id < n_pages && disk_manager->retrieve_record(page_id, frame.page);
+        if (read)
+            n_reads++;
+        else
+            frame.page = Page();
+        frame.page_id = page_id;
+        frame.pin_count = 0;
+        frame.dirty = false;
+        frame.history.clear();
+        auto history = retained.find(page_id);
+        if (history != retained.end()){ //the page was referenced before being replaced
+            frame.history.swap(history->second);
+            retained.erase(history);
+        }
+        page_table[page_id] = pos;
+        return frame;
+    }
+
+    /**
+     * @brief Pin the frame of a page
+     *
+     * @param page_id position of the page on disk
+     * @param read_page if the page has to be read from disk
+     * @return Frame& frame with the page
+     */
+    Frame& pinFrame(long page_id, bool read_page){
+        Frame &frame = fetch(page_id, read_page);
+        frame.pin_count++;
+        touch(frame);
+        if (!read_page && page_id >= n_pages)
+            n_pages = page_id + 1;
+        return frame;
+    }
+
+    /**
+     * @brief Unpin the frame of a page
+     *
+     * @param page_id position of the page on disk
+     * @param is_dirty if the page was modified
+     */
+    void unpinFrame(long page_id, bool is_dirty){
+        auto found = page_table.find(page_id);
+        if (found == page_table.end())
+            return;
+        Frame &frame = frames[found->second];
+        if (frame.pin_count > 0)
+            frame.pin_count--;
+        frame.dirty = frame.dirty || is_dirty;
+    }
+
+public:
+
+    /**
+     * @brief Construct a new Buffer Pool object
+     *
+     * @param manager disk manager of the file
+     * @param capacity number of pages kept in memory
+     * @param _k K of the LRU-K replacement policy
+     */
+    BufferPool(diskManager manager, int capacity = BUFFER_POOL_PAGES, int _k = 2)
+        : disk_manager(manager), frames(capacity > 0 ? capacity : 1), k(_k > 0 ? _k : 1){
+        n_pages = disk_manager->template count_records<Page>();
+    }
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool& operator=(const BufferPool &) = delete;
+
+    ~BufferPool(){ flushAll(); } //write back the dirty pages
+
+    /**
+     * @brief Pin a page in memory, reading it from disk if is not resident.
+     * The reference is valid until the page is unpinned
+     *
+     * @param page_id position of the page on disk
+     * @return Page& page on memory
+     */
+    Page& pin(long page_id){
+        std::lock_guard<std::mutex> lock(latch);
+        return pinFrame(page_id, true).page;
+    }
+
+    /**
+     * @brief Pin a page that is going to be overwritten completely,
+     * so it is not read from disk if is not resident
+     *
+     * @param page_id position of the page on disk
+     * @return Page& page on memory
+     */
+    Page& pinNew(long page_id){
+        std::lock_guard<std::mutex> lock(latch);
+        return pinFrame(page_id, false).page;
+    }
+
+    /**
+     * @brief Unpin a page previously pinned
+     *
+     * @param page_id position of the page on disk
+     * @param is_dirty if the page was modified
+     */
+    void unpin(long page_id, bool is_dirty){
+        std::lock_guard<std::mutex> lock(latch);
+        unpinFrame(page_id, is_dirty);
+    }
+
+    /**
+     * @brief Copy a page from the pool, if the file is memory mapped and
+     * the page isn't resident it is copied directly from the mapping
+     *
+     * @param page_id position of the page on disk
+     * @param page page to save the read value
+     */
+    void read(long page_id, Page &page){
+        std::lock_guard<std::mutex> lock(latch);
+        if (!page_table.count(page_id)){ //the mapped pages are copied without using a frame
+            const Page *mapped = disk_manager->template borrow_record<Page>(page_id);
+            if (mapped != nullptr){
+                page = *mapped;
+                return;
+            }
+        }
+        page = pinFrame(page_id, true).page;
+        unpinFrame(page_id, false);
+    }
+
+    /**
+     * @brief Copy a page to the pool, it is written to disk when
+     * it is replaced or flushed
+     *
+     * @param page_id position of the page on disk
+     * @param page page value
+     */
+    void write(long page_id, const Page &page){
+        std::lock_guard<std::mutex> lock(latch);
+        pinFrame(page_id, false).page = page;
+        unpinFrame(page_id, true);
+    }
+
+    /**
+     * @brief Write a page after the last page of the file
+     *
+     * @param page page value
+     * @return long position of the new page
+     */
+    long append(const Page &page){
+        std::lock_guard<std::mutex> lock(latch);
+        long page_id = n_pages;
+        pinFrame(page_id, false).page = page;
+        unpinFrame(page_id, true);
+        return page_id;
+    }
+
+    /**
+     * @brief Write back a page if it is resident and dirty
+     *
+     * @param page_id position of the page on disk
+     */
+    void flush(long page_id){
+        std::lock_guard<std::mutex> lock(latch);
+        auto found = page_table.find(page_id);
+        if (found != page_table.end())
+            writeBack(frames[found->second]);
+    }
+
+    /**
+     * @brief Write back all the dirty pages
+     *
+     */
+    void flushAll(){
+        std::lock_guard<std::mutex> lock(latch);
+        for (Frame &frame : frames)
+            if (frame.page_id != -1)
+                writeBack(frame);
+        disk_manager->flush();
+    }
+
+    /**
+     * @brief Write back and drop all the pages, it is used after the
+     * file was written directly by the DiskManager
+     *
+     */
+    void reset(){
+        std::lock_guard<std::mutex> lock(latch);
+        for (Frame &frame : frames){
+            if (frame.page_id != -1)
+                writeBack(frame);
+            frame.page_id = -1;
+            frame.pin_count = 0;
+            frame.history.clear();
+        }
+        disk_manager->flush();
+        page_table.clear();
+        retained.clear();
+        retained_order.clear();
+        n_pages = disk_manager->template count_records<Page>();
+    }
+
+    /**
+     * @brief Number of pages of the file
+     *
+     * @return long
+     */
+    long size(){
+        std::lock_guard<std::mutex> lock(latch);
+        return n_pages;
+    }
+
+    /**
+     * @brief Number of pages read from disk since the pool was created
+     *
+     * @return long
+     */
+    long physicalReads(){
+        std::lock_guard<std::mutex> lock(latch);
+        return n_reads;
+    }
+
+    /**
+     * @brief Number of pages written to disk since the pool was created
+     *
+     * @return long
+     */
+    long physicalWrites(){
+        std::lock_guard<std::mutex> lock(latch);
+        return n_writes;
+    }
+};
+
+/**
+ * @brief Page pinned in a buffer pool, it is read and modified in place
+ * without copying it and it is unpinned when the handle is destroyed.
+ * The handles are moved, not copied
+ *
+ * @tparam Page type of the page
+ */
+template<typename Page>
+class PageHandle{
+
+    std::shared_ptr<BufferPool<Page>> pool;
+    long page_id = -1;
+    Page *page = nullptr;
+    bool dirty = false;
+
+public:
+
+    PageHandle(){}
+
+    /**
+     * @brief Pin a page
+     *
+     * @param buffer_pool pool of the page
+     * @param id position of the page on disk
+     * @param is_new if the page is going to be overwritten completely,
+     * so it is not read from disk
+     */
+    PageHandle(std::shared_ptr<BufferPool<Page>> buffer_pool, long id, bool is_new = false)
+        : pool(std::move(buffer_pool)), page_id(id){
+        page = is_new ? &pool->pinNew(page_id) : &pool->pin(page_id);
+    }
+
+    PageHandle(const PageHandle &) = delete;
+    PageHandle& operator=(const PageHandle &) = delete;
+
+    PageHandle(PageHandle &&other) noexcept
+        : pool(std::move(other.pool)), page_id(other.page_id), page(other.page), dirty(other.dirty){
+        other.page = nullptr;
+    }
+
+    PageHandle& operator=(PageHandle &&other) noexcept{
+        if (this != &other){
+            release();
+            pool = std::move(other.pool);
+            page_id = other.page_id;
+            page = other.page;
+            dirty = other.dirty;
+            other.page = nullptr;
+        }
+        return *this;
+    }
+
+    ~PageHandle(){ release(); }
+
+    /**
+     * @brief Unpin the page, it is written back later if it was modified
+     *
+     */
+    void release(){
+        if (page != nullptr)
+            pool->unpin(page_id, dirty);
+        page = nullptr;
+        dirty = false;
+    }
+
+    /**
+     * @brief Register that the page was modified
+     *
+     */
+    void markDirty(){
+        dirty = true;
+    }
+
+    Page& operator*() const{ return *page; }
+    Page* operator->() const{ return page; }
+};
+}
@@ -14,13 +14,26 @@
  */
 #include "b_plus_tree.h"
 #include "statichashing.h"
+#include "extendible_hashing.h"
+#include "write_ahead_log.h"
+#include "block_reader.h"
+#include "record_predicate.h"
+#include "secondary_index.h"
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <utility>
 #include <thread>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <atomic>
+#include <mutex>
 
-#define B_ORDER 1000
+#define B_PAGE_SIZE 16384 //size of the B+Tree nodes on disk
+#define RECORD_BATCH 256 //records fetched together by the range scans
+#define SCAN_CHUNK (1L * 1024 * 1024) //bytes read by one I/O of the table scans
 
 namespace bd2 {
 /**
@@ -29,27 +42,95 @@ namespace bd2 {
  * @tparam Record structure of the record to be inserted
  * @tparam Key the type of the record key 
  * @tparam 10000 global depth of the static hashing
- * @tparam 20 
+ * @tparam 20 max size of each bucket
+ * @tparam HashIndex hashing index, extendible hashing by default
+ * (StaticHashing<Key, gd, fd> keeps the fixed directory)
  */
-    template<typename Record, typename Key, int gd = 10000, int fd = 20>
+    template<typename Record, typename Key, int gd = 10000, int fd = 20,
+             typename HashIndex = bd2::ExtendibleHashing<Key, fd>>
     class DataBase {
         using diskManager = std::shared_ptr<bd2::DiskManager>;
-        using btree = bd2::BPlusTree<Key, B_ORDER>;
-        using staticHashing = bd2::StaticHashing<Key, gd, fd>;
+        using btree = bd2::BPlusTree<Key, bd2::PageOrder<Key, B_PAGE_SIZE>::value>;
+        using hashIndex = HashIndex;
         long n_records;
         diskManager indexManager;
         diskManager recordManager;
         diskManager bucketManager;
         btree index;
-        staticHashing indexSH;
+        hashIndex indexSH;
         int kind_of_index;
+        bool reopened = false; //the data file had records when it was opened, the existing secondary indexes are kept
+        std::shared_ptr<WriteAheadLog> wal;
+        std::vector<std::shared_ptr<SecondaryIndexBase<Record>>> secondary; //they are maintained by every insertion
+
+        /**
+         * @brief Add a record to the secondary indexes
+         *
+         * @param record record inserted
+         * @param pos position of the record on the data file
+         */
+        void indexSecondary(const Record &record, long pos) {
+            for (auto &sec : secondary)
+                sec->insert(record, pos);
+        }
+
+        /**
+         * @brief Remove a record of the secondary indexes
+         *
+         * @param pos position of the record on the data file
+         */
+        void unindexSecondary(long pos) {
+            if (secondary.empty() || pos == -1)
+                return;
+            Record record;
+            recordManager->retrieve_record(pos, record);
+            for (auto &sec : secondary)
+                sec->erase(record, pos);
+        }
+
+        /**
+         * @brief Flags of the records that the primary index can reach, the
+         * records erased through the index stay in the data file but they
+         * aren't reachable. Without index every record is reachable
+         *
+         * @return std::vector<bool> one flag per position of the data file
+         */
+        std::vector<bool> reachableRecords() {
+            bool indexed = kind_of_index == 0 || kind_of_index == 1;
+            std::vector<bool> reachable(n_records, !indexed);
+            auto mark = [&reachable](long pos){
+                if (pos >= 0 && pos < (long) reachable.size())
+                    reachable[pos] = true;
+            };
+            if (kind_of_index == 0)
+                index.scan([&mark](const Key &, long pos){
+                    mark(pos);
+                    return true;
+                });
+            if (kind_of_index == 1)
+                indexSH.forEach([&mark](const Key &, long pos){
+                    mark(pos);
+                });
+            return reachable;
+        }
+
+        /**
+         * @brief Register the end of an operation in the write-ahead log,
+         * the group is committed when it is complete
+         *
+         */
+        void operationDone() {
+            if (wal && wal->operationDone())
+                commit();
+        }
+
     public:
 
         /**
          * @brief Construct a new Data Base object
          * 
          * @param k_index type of index to be selected, 
-         * (0) B+Tree (1)Static Hashing (else) Without Index
+         * (0) B+Tree (1) Hashing (else) Without Index
          */
         DataBase(int k_index = 0) {
             n_records = 0;
@@ -61,7 +142,7 @@ namespace bd2 {
             }
             if (k_index == 1) {
                 bucketManager = std::make_shared<bd2::DiskManager>("bucket.bin", true);
-                indexSH = staticHashing(bucketManager, recordManager);
+                indexSH = hashIndex(bucketManager, recordManager);
             }
         }
 
@@ -75,6 +156,7 @@ namespace bd2 {
          */
         DataBase(diskManager idxMan, diskManager recMan, int _n_records, int k_index = 0) {
             recordManager = std::move(recMan);
+            reopened = !recordManager->is_empty();
             kind_of_index = k_index;
             if (kind_of_index == 0){
                 indexManager = std::move(idxMan);
@@ -82,11 +164,74 @@ namespace bd2 {
             }
             if (kind_of_index == 1){
                 bucketManager = idxMan;
-                indexSH = staticHashing (bucketManager, recordManager);
+                indexSH = hashIndex(bucketManager, recordManager);
             }
             n_records = _n_records;
         }
 
+        /**
+         * @brief Commit the pending operations before closing
+         *
+         */
+        ~DataBase() {
+            if (wal)
+                commit();
+        }
+
+        /**
+         * @brief Protect the database with a write-ahead log: the writes of
+         * the data and index files are committed in groups of operations
+         * with one fsync per group. The committed groups of an existing log
+         * are replayed first, so a database closed by a crash is recovered
+         *
+         * @param log_path filename of the log
+         * @param group_size operations committed by one fsync
+         * @param reset flag to truncate the log instead of replaying it
+         * @return long number of groups replayed
+         */
+        long enableWriteAheadLog(const std::string &log_path, int group_size = WAL_GROUP_SIZE, bool reset = false) {
+            if (kind_of_index == 0)
+                index.flush();
+            if (kind_of_index == 1)
+                indexSH.flush();
+            for (auto &sec : secondary)
+                sec->flush();
+            wal = std::make_shared<WriteAheadLog>(log_path, group_size, reset);
+            wal->attach(recordManager);
+            if (kind_of_index == 0)
+                wal->attach(indexManager);
+            if (kind_of_index == 1)
+                wal->attach(bucketManager);
+            for (auto &sec : secondary)
+                wal->attach(sec->file());
+            long replayed = wal->recover();
+            if (kind_of_index == 0) //the index is read again from the recovered files
+                index = btree(indexManager);
+            if (kind_of_index == 1)
+                indexSH = hashIndex(bucketManager, recordManager);
+            for (auto &sec : secondary)
+                sec->reload();
+            n_records = std::max(n_records, recordManager->count_records<Record>());
+            return replayed;
+        }
+
+        /**
+         * @brief Make the operations done since the last commit durable,
+         * it does nothing if the write-ahead log isn't enabled
+         *
+         */
+        void commit() {
+            if (!wal)
+                return;
+            if (kind_of_index == 0)
+                index.flush();
+            if (kind_of_index == 1)
+                indexSH.flush();
+            for (auto &sec : secondary)
+                sec->flush();
+            wal->commit();
+        }
+
         /**
          * @brief Insert without index
          * 
@@ -94,49 +239,207 @@ namespace bd2 {
          */
         void insertWithoutIndex(Record &record) {
             recordManager->write_record(n_records, record);
+            indexSecondary(record, n_records);
             n_records++;
+            operationDone();
         }
 
         /**
-         * @brief Sequential search without indexes
+         * @brief Sequential search without indexes, the file is read in
+         * blocks of SCAN_CHUNK bytes
          * 
          * @param record record in which we are going to store the result
          * @param key_value value to be finded
-         * @param disk_access quantity of disk access
-         */
-        void findWithoutIndex(Record &record, Key key_value, int &disk_access){
-            disk_access = 0;
-            for (int i = 0; i < n_records; i++){
-                recordManager->retrieve_record(i, record);
-                disk_access++;
-                if (record.id == key_value){
-                    std::cout << "Disk access: " << disk_access << std::endl;
-                    break;
-                }
+         * @param disk_access quantity of disk access, the records read until
+         * the match (all the records if there is no match)
+         * @param blocks_read if it isn't null, blocks read from the file
+         */
+        void findWithoutIndex(Record &record, Key key_value, int &disk_access, int *blocks_read = nullptr){
+            std::vector<long> found = scanKey(key_value, true, 1, blocks_read);
+            disk_access = found.empty() ? (int) n_records : (int) found[0] + 1;
+            if (!found.empty()){
+                recordManager->retrieve_record(found[0], record);
+                std::cout << "Disk access: " << disk_access << std::endl;
             }
         }
 
         /**
-         * @brief Load data to the Database from an external file
+         * @brief Read the data file in blocks of SCAN_CHUNK bytes, the file
+         * is split in one partition per thread
+         *
+         * @tparam BlockFn callable as bool(int t, long pos, const Record *block,
+         * long count), it returns false to stop the partition t
+         * @param n_threads threads scanning partitions of the file
+         * @param fn function called for each block
+         * @return int number of blocks read
+         */
+        template<typename BlockFn>
+        int scanBlocks(int n_threads, BlockFn fn){
+            long n = n_records;
+            n_threads = (int) std::max(1L, std::min<long>(n_threads, n));
+            long slice = (n + n_threads - 1) / n_threads;
+            long chunk = std::max(1L, SCAN_CHUNK / (long) sizeof(Record));
+            std::atomic<int> reads(0);
+            auto scanPartition = [&](int t){
+                long begin = std::min(n, t * slice);
+                long end = std::min(n, begin + slice);
+                std::vector<Record> block(std::min(chunk, std::max(1L, end - begin)));
+                for (long pos = begin; pos < end; pos += chunk){
+                    long count = recordManager->retrieve_block(pos, block.data(), std::min(chunk, end - pos));
+                    reads++;
+                    if (!fn(t, pos, (const Record *) block.data(), count))
+                        break;
+                }
+            };
+            std::vector<std::thread> threads;
+            for (int t = 1; t < n_threads; t++)
+                threads.emplace_back(scanPartition, t);
+            scanPartition(0);
+            for (std::thread &thread : threads)
+                thread.join();
+            return reads;
+        }
+
+        /**
+         * @brief Full scan of the data file, the ids of each block are
+         * compared without branches, so the scan is bound by the
+         * sequential bandwidth
+         *
+         * @param key_value value to be finded
+         * @param stop_at_first the scan stops at the first match
+         * @param n_threads threads scanning partitions of the file
+         * @param blocks_read if it isn't null, blocks read
+         * @return std::vector<long> positions of the matching records in
+         * order, only the first one if stop_at_first
+         */
+        std::vector<long> scanKey(Key key_value, bool stop_at_first = false, int n_threads = 1, int *blocks_read = nullptr){
+            std::atomic<long> first(std::numeric_limits<long>::max());
+            std::vector<std::vector<long>> matches(std::max(1, n_threads));
+            int reads = scanBlocks(n_threads, [&](int t, long pos, const Record *block, long count){
+                if (stop_at_first && pos >= first.load())
+                    return false; //a match was found before this block
+                if (!anyKey(block, count, key_value))
+                    return true;
+                for (long i = 0; i < count; i++){
+                    if (!(block[i].id == key_value))
+                        continue;
+                    matches[t].push_back(pos + i);
+                    if (stop_at_first){
+                        long current = first.load();
+                        while (pos + i < current && !first.compare_exchange_weak(current, pos + i));
+                        return false;
+                    }
+                }
+                return true;
+            });
+            if (blocks_read)
+                *blocks_read = reads;
+
+            std::vector<long> result;
+            for (auto &partition : matches)
+                result.insert(result.end(), partition.begin(), partition.end());
+            if (stop_at_first && result.size() > 1)
+                result.resize(1);
+            return result;
+        }
+
+        /**
+         * @brief Stream the records that satisfy a predicate, the data file
+         * is scanned in blocks by n_threads threads. The callback is called
+         * by one thread at a time, in the order of the file if n_threads
+         * is 1
+         *
+         * @tparam Predicate callable as bool(const Record &record), see
+         * record_predicate.h
+         * @tparam Callback callable as bool(long pos, const Record &record),
+         * it returns false to stop the scan
+         * @param predicate filter of the records
+         * @param callback function called for each matching record
+         * @param n_threads threads scanning partitions of the file
+         * @return long number of records passed to the callback
+         */
+        template<typename Predicate, typename Callback>
+        long scanWhere(Predicate predicate, Callback callback, int n_threads = 1){
+            std::atomic<bool> stopped(false);
+            std::mutex callback_latch;
+            long n = 0;
+            scanBlocks(n_threads, [&](int, long pos, const Record *block, long count){
+                for (long i = 0; i < count && !stopped.load(); i++){
+                    if (!predicate(block[i]))
+                        continue;
+                    std::lock_guard<std::mutex> lock(callback_latch);
+                    if (stopped.load())
+                        break;
+                    n++;
+                    if (!callback(pos + i, block[i]))
+                        stopped = true;
+                }
+                return !stopped.load();
+            });
+            return n;
+        }
+
+        /**
+         * @brief Positions of the records that satisfy a predicate
+         *
+         * @tparam Predicate callable as bool(const Record &record)
+         * @param predicate filter of the records
+         * @param n_threads threads scanning partitions of the file
+         * @param limit max positions to be returned, -1 without limit, with
+         * many threads they aren't always the first ones of the file
+         * @return std::vector<long> positions in the order of the file
+         */
+        template<typename Predicate>
+        std::vector<long> selectWhere(Predicate predicate, int n_threads = 1, long limit = -1){
+            std::vector<long> result;
+            scanWhere(predicate, [&](long pos, const Record &){
+                result.push_back(pos);
+                return limit < 0 || (long) result.size() < limit;
+            }, n_threads);
+            std::sort(result.begin(), result.end());
+            return result;
+        }
+
+        /**
+         * @brief Check if a block has a record with the key, the loop has
+         * no branches so the compiler can vectorize the strided compare
+         *
+         * @param block records of the block
+         * @param count number of records
+         * @param key_value value to be finded
+         * @return true some record has the key
+         */
+        static bool anyKey(const Record *block, long count, const Key &key_value){
+            bool found = false;
+            for (long i = 0; i < count; i++)
+                found |= (block[i].id == key_value);
+            return found;
+        }
+
+        /**
+         * @brief Load data to the Database from an external file, if the
+         * B+Tree index is empty it is built with a bulk load. It uses one
+         * thread unless the caller asks for the parallel ingestion
          * 
          * @param filename filename of the data
+         * @param fill_factor fill factor of the nodes of a bulk loaded B+Tree
+         * @param n_threads worker threads, 0 uses one per core
          */
-        void loadFromExternalFile(const std::string &filename) {
-            std::fstream fileIn;
-            fileIn.open(filename, std::ios::in | std::ios::binary);
-            Record r;
-            while (fileIn.read((char *) &r, sizeof(r))) {
-                //r.show();
-                if (kind_of_index == 0)
-                    insertWithBPlusTreeIndex(r, r.id, false);
-                else if (kind_of_index == 1) {
-                    //std::cout<<"ID register::"<<r.id<<std::endl;
-                    insertWithStaticHashing(r);
-                }else{
-                    insertWithoutIndex(r);
-                }
-            }
-            fileIn.close();
+        void loadFromExternalFile(const std::string &filename, double fill_factor = 1.0, int n_threads = 1) {
+            insertWithThreads(filename, n_threads, fill_factor);
+        }
+
+        /**
+         * @brief Load data from an external file and build the B+Tree index
+         * bottom-up: the records are appended to the data file, the
+         * (key, record id) pairs are sorted and the index is written in
+         * one sequential pass
+         *
+         * @param filename filename of the data
+         * @param fill_factor fill factor of the nodes of the B+Tree
+         */
+        void bulkLoadFromExternalFile(const std::string &filename, double fill_factor = 1.0) {
+            insertWithThreads(filename, 1, fill_factor);
         }
 
         /**
@@ -153,18 +456,40 @@ namespace bd2 {
                 if (!index.isKeyPresent(key_value)) {
                     index.insert(key_value, n_records);
                     recordManager->write_record(n_records, record);
+                    indexSecondary(record, n_records);
                     n_records++;
+                    operationDone();
                     return true;
                 }
                 return false;
             } else {
                 index.insert(key_value, n_records);
                 recordManager->write_record(n_records, record);
+                indexSecondary(record, n_records);
                 n_records++;
+                operationDone();
                 return true;
             }
         }
 
+        /**
+         * @brief Erase a key from the B+Tree index, the record stays in the
+         * data file but it can't be reached by the index
+         *
+         * @param key_value key of the record to be erased
+         * @return true the key was erased
+         * @return false the key doesn't exist
+         */
+        bool eraseWithBPlusTreeIndex(Key key_value) {
+            if (!secondary.empty()){
+                int disk_access = 0;
+                unindexSecondary(index.getRecordIdByKeyValue(key_value, disk_access));
+            }
+            bool erased = index.erase(key_value);
+            operationDone();
+            return erased;
+        }
+
         /**
          * @brief Read a record with B+Tree index
          * 
@@ -185,24 +510,70 @@ namespace bd2 {
         }
 
 
+        /**
+         * @brief Stream the records of a range using B+Tree, the positions
+         * are collected in batches of RECORD_BATCH and each batch is read
+         * with one multi-get, so the memory used doesn't depend on the size
+         * of the range and the records aren't read one seek at a time. The
+         * records that can't be read from the data file are skipped
+         *
+         * @tparam Callback callable as bool(Record &record), it returns
+         * false to stop the scan
+         * @param first first key value
+         * @param last last key value
+         * @param callback function called for each record
+         * @param limit max records to be read, -1 without limit
+         * @return long number of records passed to the callback
+         */
+        template<typename Callback>
+        long scanRecordRange (Key first, Key last, Callback callback, long limit = -1){
+            std::vector<long> batch;
+            std::vector<Record> records;
+            std::vector<char> read;
+            long n = 0;
+            bool stopped = false;
+            auto deliver = [&](){
+                recordManager->retrieve_records(batch, records, 1, &read);
+                for (size_t i = 0; i < records.size(); i++){
+                    if (!read[i]) //the record couldn't be read
+                        continue;
+                    n++;
+                    if (!callback(records[i])){
+                        stopped = true;
+                        break;
+                    }
+                }
+                batch.clear();
+                return !stopped;
+            };
+            index.range_scan (first, last, [&](const Key &, long pos_){
+                if (pos_ == -1)
+                    return true;
+                batch.push_back (pos_);
+                if ((long) batch.size () == RECORD_BATCH)
+                    return deliver();
+                return true;
+            }, limit);
+            if (!stopped && !batch.empty ())
+                deliver();
+            return n;
+        }
+
         /**
          * @brief Make a Range Search using B+Tree
          * 
          * @param vector_record Vector in which we are going to store the result
          * @param first first key value
          * @param last last key value
+         * @param limit max records to be read, -1 without limit
          * @return true successfull
          * @return false wrong
          */
-        bool readRecordRange (std::vector<Record> &vector_record, Key first, Key last){
-            std::vector <long> pos_records = index.range_search (first, last);
-            for (long pos_ : pos_records){
-                if (pos_ != -1) {
-                    Record new_r;
-                    recordManager->retrieve_record(pos_, new_r);
-                    vector_record.push_back (new_r);
-                }
-            }
+        bool readRecordRange (std::vector<Record> &vector_record, Key first, Key last, long limit = -1){
+            scanRecordRange (first, last, [&vector_record](Record &record){
+                vector_record.push_back (record);
+                return true;
+            }, limit);
             if (vector_record.size () > 0)
                 return true;
             return false;
@@ -226,7 +597,9 @@ namespace bd2 {
         void insertWithStaticHashing(Record &record) {
             recordManager->write_record(n_records, record);
             indexSH.insert(n_records, record.id);
+            indexSecondary(record, n_records);
             n_records++;
+            operationDone();
         }
 
         /**
@@ -243,22 +616,209 @@ namespace bd2 {
             recordManager->retrieve_record(record_pos,record);
             return true;
           }
-          retur
-          n false;
+          return false;
+        }
+        /**
+         * @brief Erase a key from the Static Hashing index, the record stays
+         * in the data file but it can't be reached by the index
+         *
+         * @param key_value key of the record to be erased
+         * @return true the key was erased
+         * @return false the key doesn't exist
+         */
+        bool eraseWithStaticHashing(Key key_value) {
+            if (!secondary.empty())
+                unindexSecondary(indexSH.search(key_value));
+            bool erased = indexSH.erase(key_value);
+            operationDone();
+            return erased;
         }
+
         void showStaticHashingIndex() {
             indexSH.print();
         }
 
-        //Methos With Threads
-        void insertWithThreads(int size,int n_threads){
-            std::vector<std::thread> threads;
-           // for(int i=0;i<)
+        //Secondary Indexes Methods
+        /**
+         * @brief Declare a secondary index over the field F, it is
+         * maintained by every insertion and erase. If the data file was
+         * reopened, an existing index file is reopened as it is, so the
+         * index has to be declared every time the database is opened, and
+         * in the same order if the write-ahead log is used. A new index is
+         * built from the records reachable by the primary index, only their
+         * field and position are kept in memory
+         *
+         * @tparam F field descriptor, e.g. BD2_FIELD(Default, city)
+         * @param filename filename of the index
+         * @return std::shared_ptr<SecondaryIndex<Record, F, B_PAGE_SIZE>> index
+         * used for equality and range lookups
+         */
+        template<typename F>
+        std::shared_ptr<SecondaryIndex<Record, F, B_PAGE_SIZE>> addSecondaryIndex(const std::string &filename) {
+            using secondaryIndex = SecondaryIndex<Record, F, B_PAGE_SIZE>;
+            auto manager = std::make_shared<bd2::DiskManager>(filename, !reopened);
+            bool build = manager->is_empty();
+            auto sec = std::make_shared<secondaryIndex>(manager);
+            if (build && n_records > 0){
+                std::vector<bool> reachable = reachableRecords();
+                std::vector<typename secondaryIndex::entry> entries;
+                scanBlocks(1, [&entries, &reachable](int, long pos, const Record *block, long count){
+                    for (long i = 0; i < count; i++)
+                        if (reachable[pos + i])
+                            entries.push_back(secondaryIndex::makeEntry(block[i], pos + i));
+                    return true;
+                });
+                if (!entries.empty())
+                    sec->build(entries);
+            }
+            if (wal){
+                sec->flush();
+                wal->attach(manager);
+            }
+            secondary.push_back(sec);
+            return sec;
         }
-        void insertThread(long begin,long end){
-            //recordManager->write_record(n_records, record);
-            //indexSH.insert(n_records, record.id);
-            n_records++;
+
+        /**
+         * @brief Read the records of the ids found by an index, the records
+         * are read with one multi-get
+         *
+         * @param record_ids positions of the records
+         * @param records records in the order of the ids
+         * @return long number of records read
+         */
+        long readRecords(const std::vector<long> &record_ids, std::vector<Record> &records) {
+            return recordManager->retrieve_records(record_ids, records);
+        }
+
+        //Methods With Threads
+        /**
+         * @brief Parallel ingestion of an external file. Each worker takes a
+         * slice of the file, streams it in chunks of BLOCK_READER_CHUNK bytes,
+         * writes each chunk to the data file with one I/O at the offsets
+         * reserved for the slice and builds a sorted run of (key, record id). The runs are
+         * merged and the index is built once: with a bulk load if the B+Tree
+         * is empty, else with inserts in key order. With the write-ahead log
+         * enabled one worker is used and each chunk is committed.
+         * With many workers the data file is switched to the POSITIONAL mode
+         * while they write, the STREAM and MMAP modes serialize every write
+         * on one latch, and it is switched back at the end. The workers
+         * update the secondary indexes concurrently, each record as it is
+         * written, relying on the latches of their B+Trees
+         *
+         * @param filename filename of the data
+         * @param n_threads worker threads, 0 uses one per core
+         * @param fill_factor fill factor of the nodes of a bulk loaded B+Tree
+         * @return long number of records loaded
+         */
+        long insertWithThreads(const std::string &filename, int n_threads = 0, double fill_factor = 1.0) {
+            std::ifstream fileIn(filename, std::ios::in | std::ios::binary | std::ios::ate);
+            if (!fileIn)
+                return 0;
+            long n = (long) fileIn.tellg() / (long) sizeof(Record);
+            fileIn.close();
+            if (n_threads <= 0)
+                n_threads = std::max(1, (int) std::thread::hardware_concurrency());
+            if (wal)
+                n_threads = 1; //the log commits the blocks in order
+            n_threads = (int) std::max(1L, std::min<long>(n_threads, n));
+
+            DiskManager::mode data_mode = recordManager->get_mode();
+            if (n_threads > 1)
+                recordManager->reopen(DiskManager::POSITIONAL); //pwrite doesn't share a cursor
+
+            long base = n_records;
+            long slice = (n + n_threads - 1) / n_threads;
+            std::vector<std::vector<std::pair<Key, long>>> runs(n_threads);
+            std::vector<std::thread> workers;
+            for (int t = 0; t < n_threads; t++){
+                long begin = std::min(n, t * slice);
+                long end = std::min(n, begin + slice);
+                if (t + 1 == n_threads)
+                    insertThread(filename, begin, end, base, runs[t]); //the current thread is a worker too
+                else
+                    workers.emplace_back(&DataBase::insertThread, this, std::cref(filename), begin, end, base, std::ref(runs[t]));
+            }
+            for (std::thread &worker : workers)
+                worker.join();
+            recordManager->reopen(data_mode);
+            n_records = base + n;
+
+            std::vector<std::pair<Key, long>> entries = mergeRuns(runs);
+            if (kind_of_index == 0){
+                if (!index.isEmpty() || !index.bulkLoad(entries.begin(), entries.end(), fill_factor))
+                    for (auto &entry : entries)
+                        index.insert(entry.first, entry.second);
+            }
+            else if (kind_of_index == 1){
+                for (auto &entry : entries)
+                    indexSH.insert(entry.second, entry.first);
+            }
+            commit();
+            return n;
+        }
+
+        /**
+         * @brief Worker of the parallel ingestion, it loads the records
+         * [begin, end) of the file
+         *
+         * @param filename filename of the data
+         * @param begin first record of the slice
+         * @param end end of the slice
+         * @param base position of the first record of the file in the data file
+         * @param run sorted (key, record id) of the slice
+         */
+        void insertThread(const std::string &filename, long begin, long end, long base, std::vector<std::pair<Key, long>> &run) {
+            BlockReader<Record> reader(filename, begin, end); //the next chunk is read while this one is written
+            run.reserve(end - begin);
+            const Record *block;
+            long count;
+            long pos = begin;
+            while (reader.next(block, count)){
+                recordManager->write_records(base + pos, block, count);
+                for (long i = 0; i < count; i++){
+                    run.push_back(std::make_pair((Key) block[i].id, base + pos + i));
+                    indexSecondary(block[i], base + pos + i); //the B+Tree latches allow concurrent inserts
+                }
+                pos += count;
+                if (wal)
+                    commit();
+            }
+            std::stable_sort(run.begin(), run.end(),
+                             [](const std::pair<Key, long> &a, const std::pair<Key, long> &b) {
+                                 return a.first < b.first;
+                             });
+        }
+
+        /**
+         * @brief Merge the sorted runs of the workers, the runs are merged
+         * by pairs and the equal keys keep the order of the file
+         *
+         * @param runs sorted runs in the order of the file, they are released
+         * @return std::vector<std::pair<Key, long>> sorted (key, record id)
+         */
+        static std::vector<std::pair<Key, long>> mergeRuns(std::vector<std::vector<std::pair<Key, long>>> &runs) {
+            auto byKey = [](const std::pair<Key, long> &a, const std::pair<Key, long> &b) {
+                return a.first < b.first;
+            };
+            while (runs.size() > 1){
+                std::vector<std::vector<std::pair<Key, long>>> merged;
+                for (size_t i = 0; i + 1 < runs.size(); i += 2){
+                    std::vector<std::pair<Key, long>> out;
+                    out.reserve(runs[i].size() + runs[i + 1].size());
+                    std::merge(runs[i].begin(), runs[i].end(), runs[i + 1].begin(), runs[i + 1].end(),
+                               std::back_inserter(out), byKey);
+                    std::vector<std::pair<Key, long>>().swap(runs[i]);
+                    std::vector<std::pair<Key, long>>().swap(runs[i + 1]);
+                    merged.push_back(std::move(out));
+                }
+                if (runs.size() % 2 == 1)
+                    merged.push_back(std::move(runs.back()));
+                runs.swap(merged);
+            }
+            if (runs.empty())
+                return std::vector<std::pair<Key, long>>();
+            return std::move(runs[0]);
         }
     };
 }
@@ -15,13 +15,215 @@
 #include<fstream>
 #include<iostream>
 #include<string>
+#include<map>
+#include<mutex>
+#include<algorithm>
+#include<atomic>
+#include<vector>
+#include<thread>
+#include<utility>
+#include<cstring>
+#include "mapped_file.h"
+#include "positional_file.h"
+
+#define MULTI_GET_RUN (1L * 1024 * 1024) //max bytes read by one I/O of retrieve_records
 
 namespace bd2{
 
+class WriteAheadLog;
+
 class DiskManager : protected std::fstream{
 
+  public:
+
+    /**
+     * @brief Backend used to access the file
+     * STREAM: std::fstream with seek + read/write
+     * MMAP: memory mapped file, records can be borrowed without copies
+     * POSITIONAL: pread/pwrite without a shared cursor, it can be shared
+     * by many threads
+     */
+    enum mode { STREAM, MMAP, POSITIONAL };
+
+  private:
+
   std::string filePath;
-  bool empty;
+  std::atomic<bool> empty{false}; //the file had no records when it was opened and nothing was written
+  mode disk_mode = STREAM;
+  MappedFile mapped; //storage of the MMAP mode
+  PositionalFile positional; //storage of the POSITIONAL mode
+  std::mutex io_latch; //the stream cursor and the mapping are shared, so the STREAM and MMAP modes serialize the accesses
+
+  //writes of a file attached to a write-ahead log, they are kept here
+  //(and seen by the reads) until the log commits them to the file
+  bool logged = false;
+  std::map<long, std::string> pending; //offset -> bytes, the pending writes don't overlap
+  long pending_end = 0; //last byte of the pending writes
+  long pending_max = 0; //size of the largest pending write
+  std::mutex pending_latch;
+
+  friend class WriteAheadLog;
+
+  /**
+   * @brief Write bytes to the storage of the current mode
+   *
+   * @param offset position on the file
+   * @param src bytes to be written
+   * @param n number of bytes
+   */
+  void write_bytes(long offset, const void *src, long n){
+    if(disk_mode == POSITIONAL){
+      positional.write(offset,src,n);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(io_latch);
+    if(disk_mode == MMAP){
+      mapped.write(offset,src,n);
+      return;
+    }
+    clear(); //reset flags bit (goodbit, eofbit, failbit, badbit)
+    seekp(offset,std::ios::beg);
+    write(static_cast<const char*>(src),n);
+  }
+
+  /**
+   * @brief Write bytes at the end of the storage
+   *
+   * @param src bytes to be written
+   * @param n number of bytes
+   * @return long position in which the bytes were written, -1 if an error occurs
+   */
+  long append_bytes(const void *src, long n){
+    if(disk_mode == POSITIONAL)
+      return positional.append(src,n);
+    std::lock_guard<std::mutex> lock(io_latch);
+    long offset = unlatched_size()/n*n;
+    if(disk_mode == MMAP)
+      return mapped.write(offset,src,n) ? offset : -1;
+    clear();
+    seekp(offset,std::ios::beg);
+    write(static_cast<const char*>(src),n);
+    return offset;
+  }
+
+  /**
+   * @brief Read bytes from the storage of the current mode
+   *
+   * @param offset position on the file
+   * @param dst buffer to save the read bytes
+   * @param n number of bytes
+   * @return long bytes read
+   */
+  long read_bytes(long offset, void *dst, long n){
+    if(disk_mode == POSITIONAL)
+      return positional.read(offset,dst,n);
+    std::lock_guard<std::mutex> lock(io_latch);
+    if(disk_mode == MMAP)
+      return mapped.read(offset,dst,n);
+    clear();
+    seekg(offset,std::ios::beg);
+    read(static_cast<char*>(dst),n);
+    return gcount(); //Returns the number of characters extracted by the last unformatted input operation performed on the fstrem .
+  }
+
+  /**
+   * @brief Bytes stored in the file, without the pending writes
+   *
+   * @return long
+   */
+  long storage_size(){
+    if(disk_mode == POSITIONAL)
+      return positional.size();
+    std::lock_guard<std::mutex> lock(io_latch);
+    return unlatched_size();
+  }
+
+  /**
+   * @brief Bytes stored in the file, the io latch has to be held
+   *
+   * @return long
+   */
+  long unlatched_size(){
+    if(disk_mode == MMAP)
+      return mapped.size();
+    clear();
+    seekg(0,std::ios::end);
+    long size=tellg();
+    return size < 0 ? 0 : size;
+  }
+
+  /**
+   * @brief Bytes of the file including the pending writes
+   *
+   * @return long
+   */
+  long logical_size(){
+    return std::max(storage_size(), pending_end);
+  }
+
+  /**
+   * @brief Keep a write until the log commits it, the pending writes it
+   * overlaps are merged with it and its bytes are copied over them, so
+   * the newest bytes win whatever the order of the offsets
+   *
+   * @param offset position on the file
+   * @param src bytes to be written
+   * @param n number of bytes
+   */
+  void stage(long offset, const void *src, long n){
+    auto first = pending.lower_bound(offset - pending_max + 1);
+    while(first != pending.end() && first->first + (long)first->second.size() <= offset)
+      ++first;
+    long begin = offset, end = offset+n;
+    auto last = first;
+    for(; last != pending.end() && last->first < offset+n; ++last){
+      begin = std::min(begin, last->first);
+      end = std::max(end, last->first + (long)last->second.size());
+    }
+    std::string bytes(end-begin,'\0');
+    for(auto it = first; it != last; ++it)
+      std::copy(it->second.begin(), it->second.end(), bytes.begin() + (it->first - begin));
+    std::memcpy(&bytes[offset-begin],src,n);
+    pending.erase(first,last);
+    pending.emplace(begin,std::move(bytes));
+    pending_end = std::max(pending_end, end);
+    pending_max = std::max(pending_max, end-begin);
+  }
+
+  /**
+   * @brief Copy the pending writes that overlap a range of bytes
+   *
+   * @param offset position on the file
+   * @param dst buffer with the bytes read from the storage
+   * @param n number of bytes
+   * @return long last byte of the range covered by a pending write
+   */
+  long overlay(long offset, char *dst, long n){
+    long covered = 0;
+    for(auto it = pending.lower_bound(offset - pending_max + 1); it != pending.end() && it->first < offset+n; ++it){
+      long from = std::max(offset, it->first);
+      long to = std::min(offset+n, it->first + (long)it->second.size());
+      if(from >= to)
+        continue;
+      std::copy(it->second.data() + (from - it->first), it->second.data() + (to - it->first), dst + (from - offset));
+      covered = std::max(covered, to - offset);
+    }
+    return covered;
+  }
+
+  /**
+   * @brief Check if a pending write overlaps a range of bytes
+   *
+   * @param offset position on the file
+   * @param n number of bytes
+   * @return true there is a pending write on the range
+   */
+  bool overlaps(long offset, long n){
+    for(auto it = pending.lower_bound(offset - pending_max + 1); it != pending.end() && it->first < offset+n; ++it)
+      if(it->first + (long)it->second.size() > offset)
+        return true;
+    return false;
+  }
 
   public:
 
@@ -35,17 +237,57 @@ class DiskManager : protected std::fstream{
      *
      * @param fp filename of the index file
      * @param reset flag to truncate or not the current filename
+     * @param _mode backend used to access the file
      */
-      DiskManager(std::string fp, bool reset = false):std::fstream(fp.data(),std::ios::in | std::ios::out | std::ios::binary){
+      DiskManager(std::string fp, bool reset = false, mode _mode = STREAM){
           filePath = fp;
+          disk_mode = _mode;
           empty=false;
+        if(disk_mode == MMAP){
+          empty = !mapped.open(filePath, reset);
+          return;
+        }
+        if(disk_mode == POSITIONAL){
+          empty = !positional.open(filePath, reset);
+          return;
+        }
+        open(filePath.data(),std::ios::in | std::ios::out | std::ios::binary);
         if(!good() || reset){ //good check if any flag bit without googbit is on
           empty=true;
+          close(); //open fails if the stream is already open
           open(filePath.data(),std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc );
         }
       }
 
-      ~DiskManager(){ close();} //close the open file
+      ~DiskManager(){ close(); mapped.close(); positional.close();} //close the open file
+
+      /**
+       * @brief Close the file and open it again with another backend, the
+       * records are kept. It is used to write a file from many threads
+       * (POSITIONAL) and has to be called while nobody else uses the file
+       *
+       * @param _mode backend used to access the file from now on
+       */
+      void reopen(mode _mode){
+        if(_mode == disk_mode)
+          return;
+        std::lock_guard<std::mutex> lock(io_latch);
+        if(disk_mode == MMAP)
+          mapped.close(); //the file is truncated to its real size
+        else if(disk_mode == POSITIONAL)
+          positional.close();
+        else{
+          clear();
+          close();
+        }
+        disk_mode = _mode;
+        if(disk_mode == MMAP)
+          mapped.open(filePath, false);
+        else if(disk_mode == POSITIONAL)
+          positional.open(filePath, false);
+        else
+          open(filePath.data(),std::ios::in | std::ios::out | std::ios::binary);
+      }
 
     /**
      * @brief Write a record to a disk file
@@ -56,26 +298,55 @@ class DiskManager : protected std::fstream{
      */
       template<typename Record>
       void write_record(const long &n, Record &reg){
-        clear(); //reset flags bit (goodbit, eofbit, failbit, badbit)
-        seekp(n*sizeof(Record),std::ios::beg);
-        write(reinterpret_cast<const char*>(&reg),sizeof(reg));
+        empty=false;
+        if(logged){
+          std::lock_guard<std::mutex> lock(pending_latch);
+          stage(n*sizeof(Record),&reg,sizeof(reg));
+          return;
+        }
+        write_bytes(n*sizeof(Record),&reg,sizeof(reg));
       }
 
 
+      /**
+       * @brief Write a block of consecutive records with one I/O
+       *
+       * @tparam Record class to be stored
+       * @param n position of the first record
+       * @param regs records to be stored
+       * @param count number of records
+       */
+      template<typename Record>
+      void write_records(const long &n, const Record *regs, long count){
+        if(count<=0)
+          return;
+        empty=false;
+        if(logged){
+          std::lock_guard<std::mutex> lock(pending_latch);
+          stage(n*sizeof(Record),regs,count*sizeof(Record));
+          return;
+        }
+        write_bytes(n*sizeof(Record),regs,count*sizeof(Record));
+      }
+
       /**
        * @brief Write a record to the file's end
        * 
        * @tparam Record 
        * @param reg 
+       * @return long position of the record, -1 if an error occurs
        */
       template<typename Record>
       long write_record_to_ending(Record &reg){
-        clear(); //reset flags bit (goodbit, eofbit, failbit, badbit)
-        seekp(0,std::ios::end);
-        long pos=tellp();
-        write(reinterpret_cast<const char*>(&reg),sizeof(reg));
-        pos/=sizeof(reg);
-        return pos;
+        empty=false;
+        if(logged){
+          std::lock_guard<std::mutex> lock(pending_latch);
+          long pos=logical_size()/sizeof(reg);
+          stage(pos*sizeof(reg),&reg,sizeof(reg));
+          return pos;
+        }
+        long offset = append_bytes(&reg,sizeof(reg));
+        return offset < 0 ? -1 : offset/(long)sizeof(reg);
       }
 
     /**
@@ -89,11 +360,185 @@ class DiskManager : protected std::fstream{
      */
       template<typename Record>
       bool retrieve_record(const long &n, Record &reg){
+        long got = read_bytes(n*sizeof(Record),&reg,sizeof(reg));
+        if(logged){
+          std::lock_guard<std::mutex> lock(pending_latch);
+          if(!pending.empty())
+            got = std::max(got, overlay(n*sizeof(Record),reinterpret_cast<char*>(&reg),sizeof(reg)));
+        }
+        return got > 0;
+      }
+
+      /**
+       * @brief Read a block of consecutive records with one I/O
+       *
+       * @tparam Record class to be read
+       * @param n position of the first record
+       * @param regs buffer of at least count records
+       * @param count number of records
+       * @return long number of complete records read
+       */
+      template<typename Record>
+      long retrieve_block(const long &n, Record *regs, long count){
+        if(count<=0)
+          return 0;
+        long got = read_bytes(n*sizeof(Record),regs,count*sizeof(Record));
+        if(logged){
+          std::lock_guard<std::mutex> lock(pending_latch);
+          if(!pending.empty())
+            got = std::max(got, overlay(n*sizeof(Record),reinterpret_cast<char*>(regs),count*sizeof(Record)));
+        }
+        return std::max(0L, got)/(long)sizeof(Record);
+      }
+
+      /**
+       * @brief Read many records by their positions, the positions are
+       * sorted and the consecutive ones are read with one I/O per run, so
+       * scattered positions cost one seek per run instead of one per record.
+       * The POSITIONAL mode can read the runs with many threads
+       *
+       * @tparam Record class to be read
+       * @param positions positions of the records, -1 is skipped
+       * @param regs records in the order of the positions
+       * @param n_threads threads reading the runs, only in POSITIONAL mode
+       * @param read optional flags in the order of the positions, 1 if the
+       * record was read, the other records of regs aren't valid
+       * @return long number of records read
+       */
+      template<typename Record>
+      long retrieve_records(const std::vector<long> &positions, std::vector<Record> &regs, int n_threads = 1, std::vector<char> *read = nullptr){
+        const long size = sizeof(Record);
+        const long max_run = std::max(1L, MULTI_GET_RUN/size);
+        regs.resize(positions.size());
+        if(read)
+          read->assign(positions.size(),0);
+        std::vector<std::pair<long,size_t>> sorted; //position -> index in regs
+        sorted.reserve(positions.size());
+        for(size_t i=0;i<positions.size();i++)
+          if(positions[i]>=0)
+            sorted.push_back(std::make_pair(positions[i],i));
+        std::sort(sorted.begin(),sorted.end());
+
+        std::vector<std::pair<size_t,size_t>> runs; //[first, last) of sorted
+        for(size_t i=0;i<sorted.size();){
+          size_t j=i+1;
+          while(j<sorted.size() && sorted[j].first<=sorted[j-1].first+1 && sorted[j].first-sorted[i].first<max_run)
+            j++;
+          runs.push_back(std::make_pair(i,j));
+          i=j;
+        }
+
+        std::atomic<long> n_read{0};
+        auto readRuns = [&](size_t from, size_t step){
+          std::vector<char> buffer;
+          for(size_t r=from;r<runs.size();r+=step){
+            long first=sorted[runs[r].first].first;
+            long n=sorted[runs[r].second-1].first-first+1;
+            buffer.assign(n*size,0);
+            long got=read_bytes(first*size,buffer.data(),n*size);
+            if(logged){
+              std::lock_guard<std::mutex> lock(pending_latch);
+              if(!pending.empty())
+                got=std::max(got,overlay(first*size,buffer.data(),n*size));
+            }
+            for(size_t k=runs[r].first;k<runs[r].second;k++){
+              long offset=(sorted[k].first-first)*size;
+              if(offset+size>got) //the record isn't complete on the file
+                continue;
+              std::memcpy(static_cast<void*>(&regs[sorted[k].second]),buffer.data()+offset,size);
+              if(read)
+                (*read)[sorted[k].second]=1;
+              n_read++;
+            }
+          }
+        };
+        int workers=disk_mode==POSITIONAL ? std::min<long>(std::max(n_threads,1),runs.size()) : 1;
+        if(workers<=1){
+          readRuns(0,1);
+          return n_read;
+        }
+        std::vector<std::thread> threads;
+        for(int t=0;t<workers;t++)
+          threads.emplace_back(readRuns,t,workers);
+        for(std::thread &thread : threads)
+          thread.join();
+        return n_read;
+      }
+
+      /**
+       * @brief Borrow a record from the mapped file without copying it,
+       * the pointer is valid until the next write that grows the file
+       *
+       * @tparam Record class to be read
+       * @param n position of the record
+       * @return const Record* pointer to the record, nullptr if the mode
+       * isn't MMAP, the record is out of the file or it has a pending write
+       */
+      template<typename Record>
+      const Record* borrow_record(const long &n){
+        if(disk_mode != MMAP)
+          return nullptr;
+        if(logged){
+          std::lock_guard<std::mutex> lock(pending_latch);
+          if(overlaps(n*sizeof(Record),sizeof(Record)))
+            return nullptr;
+        }
+        return reinterpret_cast<const Record*>(mapped.borrow(n*sizeof(Record),sizeof(Record)));
+      }
+
+      /**
+       * @brief Write the stream buffer to the file
+       *
+       */
+      void flush(){
+        if(disk_mode == POSITIONAL) //pwrite doesn't buffer in user space
+          return;
+        std::lock_guard<std::mutex> lock(io_latch);
+        if(disk_mode == MMAP){
+          mapped.sync();
+          return;
+        }
         clear();
-        seekg(n*sizeof(Record),std::ios::beg);
-        //std::cout<<"POs::"<<tellg()<<std::endl;
-        read(reinterpret_cast<char *>(&reg),sizeof(reg));
-        return gcount() > 0; //Returns the number of characters extracted by the last unformatted input operation performed on the fstrem .
+        std::fstream::flush();
+      }
+
+      /**
+       * @brief Number of records stored in the file
+       *
+       * @tparam Record class stored in the file
+       * @return long number of complete records
+       */
+      template<typename Record>
+      long count_records(){
+        if(logged){
+          std::lock_guard<std::mutex> lock(pending_latch);
+          return logical_size()/(long)sizeof(Record);
+        }
+        return storage_size()/(long)sizeof(Record);
+      }
+
+      /**
+       * @brief Write the file to the device, it returns when the written
+       * bytes are durable
+       *
+       */
+      void sync(){
+        if(disk_mode == POSITIONAL){
+          positional.sync();
+          return;
+        }
+        std::lock_guard<std::mutex> lock(io_latch);
+        if(disk_mode == MMAP){
+          mapped.sync(true);
+          return;
+        }
+        clear();
+        std::fstream::flush();
+        int fd = ::open(filePath.data(), O_RDONLY); //fsync works on any descriptor of the file
+        if(fd >= 0){
+          fsync(fd);
+          ::close(fd);
+        }
       }
 
       /**
@@ -103,5 +548,12 @@ class DiskManager : protected std::fstream{
        * @return false the file has elements
        */
       inline bool is_empty(){ return empty;}
+
+      /**
+       * @brief Backend used to access the file
+       *
+       * @return mode
+       */
+      inline mode get_mode(){ return disk_mode;}
     };
 }
@@ -0,0 +1,437 @@
+/**
+ * @file extendible_hashing.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Extendible Hashing Index Implementation, the buckets are split
+ * when they are full and the directory is doubled on demand, so a point
+ * lookup reads about one bucket no matter how large the table grows.
+ * The directory is kept in memory and rebuilt from the buckets on open
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include "disk_manager.h"
+#include "buffer_pool.h"
+#include "page_allocator.h"
+#include "hash_policy.h"
+#include <memory>
+#include <vector>
+#include <iostream>
+#include <cstdint>
+
+#define EXTENDIBLE_MAX_DEPTH 24 //max global depth, then the full buckets are chained
+
+namespace bd2{
+
+/**
+ * @brief Bucket of the extendible hashing, it owns the hashes whose
+ * local_depth lower bits are equal to pattern
+ *
+ * @tparam T type of the key value
+ * @tparam fd max size in each Bucket's object
+ */
+  template<typename T,int fd>
+  class ExtendibleBucket{
+    using value_key = T;
+    public:
+      int size;
+      int local_depth; //-1 if the bucket was released
+      long pattern; //lower bits of the hashes of the bucket
+      long NextBucket; //chain of a bucket that can't be split anymore
+      bool overflow; //the bucket is in a chain, it isn't in the directory
+      long address[fd];
+      value_key keys[fd];
+      ExtendibleBucket(){
+        size=0;
+        local_depth=0;
+        pattern=0;
+        NextBucket=-1;
+        overflow=false;
+      }
+
+      /**
+       * @brief Next bucket of the free list, if the bucket was released
+       *
+       * @return long
+       */
+      long nextFreePage() const{
+        return NextBucket;
+      }
+
+      /**
+       * @brief Link a released bucket to the free list
+       *
+       * @param next next bucket of the free list
+       */
+      void linkFreePage(long next){
+        size=0;
+        local_depth=-1;
+        NextBucket=next;
+      }
+  };
+
+/**
+ * @brief ExtendibleHashing class, it has the insert/search interface of
+ * StaticHashing
+ *
+ * @tparam T type of the key value
+ * @tparam fd max size in each Bucket's object
+ * @tparam Hash hash policy, see hash_policy.h
+ */
+  template<typename T,int fd,typename Hash = DefaultHash<T>>
+  class ExtendibleHashing{
+
+    using page = std::shared_ptr<DiskManager>;
+    using value_key = T;
+    using Bucket = ExtendibleBucket<T,fd>;
+    using bucketPool = std::shared_ptr<BufferPool<Bucket>>;
+    using bucketAllocator = std::shared_ptr<PageAllocator<Bucket>>;
+
+    page control_bucket;
+    page control_data;
+    bucketPool bucket_pool; //cache of the buckets file
+    bucketAllocator allocator; //allocator of the buckets
+    std::vector<long> directory; //position of the bucket of each hash prefix
+    int global_depth = 0;
+
+    /**
+     * @brief Position in the directory of a hash
+     *
+     * @param hash hash of the key
+     * @return long
+     */
+    long slot(uint64_t hash){
+      return (long) (hash & ((1UL << global_depth) - 1));
+    }
+
+    /**
+     * @brief Build the directory from the buckets of the file, every bucket
+     * in use is pointed by the slots whose lower bits are its pattern
+     *
+     */
+    void loadDirectory(){
+      std::vector<std::pair<long,Bucket>> primaries;
+      long n_pages = allocator->size();
+      Bucket bucket;
+      for(long pos=1;pos<n_pages;pos++){
+        bucket_pool->read(pos,bucket);
+        if(bucket.local_depth<0 || bucket.overflow)
+          continue;
+        primaries.push_back(std::make_pair(pos,bucket));
+        if(bucket.local_depth>global_depth)
+          global_depth=bucket.local_depth;
+      }
+      if(primaries.empty()){ //empty file, one bucket for all the hashes
+        Bucket first;
+        long pos=allocator->allocate();
+        bucket_pool->write(pos,first);
+        primaries.push_back(std::make_pair(pos,first));
+        global_depth=0;
+      }
+      directory.assign(1L<<global_depth,-1);
+      for(auto &primary : primaries){
+        long step=1L<<primary.second.local_depth;
+        for(long i=primary.second.pattern;i<(long)directory.size();i+=step)
+          directory[i]=primary.first;
+      }
+    }
+
+    /**
+     * @brief Write the registers of a bucket starting at a position, the
+     * ones that don't fit are chained in overflow buckets
+     *
+     * @param address_bucket position of the bucket
+     * @param depth local depth of the bucket
+     * @param pattern lower bits of the hashes of the bucket
+     * @param entries (key, address) of the registers
+     */
+    void writeChain(long address_bucket, int depth, long pattern, const std::vector<std::pair<value_key,long>> &entries){
+      Bucket bucket;
+      bucket.local_depth=depth;
+      bucket.pattern=pattern;
+      for(auto &entry : entries){
+        if(bucket.size==fd){
+          long next=allocator->allocate();
+          bucket.NextBucket=next;
+          bucket_pool->write(address_bucket,bucket);
+          bucket=Bucket();
+          bucket.overflow=true;
+          bucket.local_depth=depth;
+          bucket.pattern=pattern;
+          address_bucket=next;
+        }
+        bucket.keys[bucket.size]=entry.first;
+        bucket.address[bucket.size]=entry.second;
+        bucket.size++;
+      }
+      bucket_pool->write(address_bucket,bucket);
+    }
+
+    /**
+     * @brief Split a full bucket in two buckets of local_depth+1, the
+     * directory is doubled if the bucket has the global depth. The
+     * registers of its overflow chain are split too and the overflow
+     * buckets are released, each half chains again what doesn't fit
+     *
+     * @param address_bucket position of the bucket
+     * @param bucket bucket to be split
+     */
+    void split(long address_bucket, Bucket &bucket){
+      if(bucket.local_depth==global_depth){
+        long size=directory.size();
+        directory.resize(2*size);
+        for(long i=0;i<size;i++)
+          directory[size+i]=directory[i];
+        global_depth++;
+      }
+      int depth=bucket.local_depth;
+      long pattern=bucket.pattern;
+      std::vector<std::pair<value_key,long>> halves[2];
+      Bucket current=bucket;
+      while(true){
+        for(int j=0;j<current.size;j++)
+          halves[(getHash(current.keys[j])>>depth)&1].push_back(std::make_pair(current.keys[j],current.address[j]));
+        long next=current.NextBucket;
+        if(next<=0)
+          break;
+        bucket_pool->read(next,current);
+        allocator->release(next);
+      }
+      long address_high=allocator->allocate();
+      long pattern_high=pattern | (1L<<depth);
+      writeChain(address_bucket,depth+1,pattern,halves[0]);
+      writeChain(address_high,depth+1,pattern_high,halves[1]);
+      for(long i=pattern_high;i<(long)directory.size();i+=(1L<<(depth+1)))
+        directory[i]=address_high;
+    }
+
+    /**
+     * @brief Check if a split can separate the keys of a full bucket and
+     * a new key, it can't if all of them have the same hash (e.g. a
+     * repeated key), so the directory isn't doubled in vain
+     *
+     * @param bucket full bucket
+     * @param hash hash of the new key
+     * @return true some key has a different hash
+     */
+    bool separable(Bucket &bucket, uint64_t hash){
+      for(int j=0;j<bucket.size;j++)
+        if(getHash(bucket.keys[j])!=hash)
+          return true;
+      return false;
+    }
+
+    public:
+    ExtendibleHashing(){
+    }
+
+    ExtendibleHashing(page c_bucket, page c_data, int pool_capacity = BUFFER_POOL_PAGES){
+
+      control_bucket = c_bucket;
+      control_data = c_data;
+      bucket_pool = std::make_shared<BufferPool<Bucket>>(control_bucket, pool_capacity);
+      allocator = std::make_shared<PageAllocator<Bucket>>(control_bucket, bucket_pool, 1);
+      loadDirectory();
+
+    }
+    ~ExtendibleHashing(){
+    }
+
+   /**
+     * @brief convert key value to hash, the directory uses its lower bits
+     * so the hash policy has to mix all the bits of the key
+     *
+     * @param key key's value of the register
+     */
+    uint64_t getHash(value_key key){
+      return Hash()(key);
+    }
+
+    /**
+     * @brief insert a new register in the bucket of its hash, a full bucket
+     * is split until the register fits
+     *
+     * @param address_register the adddress of register saved priorly
+     * @param key value of key registered
+     */
+    void insert(long address_register,value_key key){
+      uint64_t hash=getHash(key);
+      Bucket bucket;
+      while(true){
+        long address_bucket=directory[slot(hash)];
+        bucket_pool->read(address_bucket,bucket);
+        if(bucket.size<fd){
+          bucket.address[bucket.size]=address_register;
+          bucket.keys[bucket.size]=key;
+          bucket.size++;
+          bucket_pool->write(address_bucket,bucket);
+          return;
+        }
+        if(bucket.local_depth<EXTENDIBLE_MAX_DEPTH && separable(bucket,hash)){
+          split(address_bucket,bucket);
+          continue;
+        }
+        //the hashes of the bucket can't be separated, the register goes to the chain
+        while(bucket.NextBucket>0 && bucket.size==fd){
+          address_bucket=bucket.NextBucket;
+          bucket_pool->read(address_bucket,bucket);
+        }
+        if(bucket.size<fd){
+          bucket.address[bucket.size]=address_register;
+          bucket.keys[bucket.size]=key;
+          bucket.size++;
+          bucket_pool->write(address_bucket,bucket);
+          return;
+        }
+        Bucket new_bucket;
+        new_bucket.overflow=true;
+        new_bucket.local_depth=bucket.local_depth;
+        new_bucket.pattern=bucket.pattern;
+        new_bucket.address[0]=address_register;
+        new_bucket.keys[0]=key;
+        new_bucket.size=1;
+        long pos=allocator->allocate();
+        bucket_pool->write(pos,new_bucket);
+        bucket.NextBucket=pos;
+        bucket_pool->write(address_bucket,bucket);
+        return;
+      }
+    }
+
+    /**
+     * @brief erase a register of the index, an overflow bucket that gets
+     * empty is unlinked of its chain and released. The buckets aren't merged
+     *
+     * @param key value of key to be erased
+     * @return true the key was erased
+     * @return false the key doesn't exist
+     */
+    bool erase(value_key key){
+      long address_bucket=directory[slot(getHash(key))];
+      long prev_address=-1;
+      Bucket bucket, prev;
+      while(address_bucket>0){
+        bucket_pool->read(address_bucket,bucket);
+        for(int j=0;j<bucket.size;j++){
+          if(bucket.keys[j]!=key)
+            continue;
+          bucket.size--;
+          bucket.keys[j]=bucket.keys[bucket.size];
+          bucket.address[j]=bucket.address[bucket.size];
+          if(bucket.size==0 && prev_address!=-1){ //empty overflow bucket
+            prev.NextBucket=bucket.NextBucket;
+            bucket_pool->write(prev_address,prev);
+            allocator->release(address_bucket);
+          }
+          else
+            bucket_pool->write(address_bucket,bucket);
+          return true;
+        }
+        prev=bucket;
+        prev_address=address_bucket;
+        address_bucket=bucket.NextBucket;
+      }
+      return false;
+    }
+
+     /**
+     * @brief search a register by its key and return the register's address
+     *
+     * @param key value of key
+     * @return long address of the register, -1 if it doesn't exist
+     */
+    long search(value_key key){
+      long address_bucket=directory[slot(getHash(key))];
+      Bucket bucket;
+      while(address_bucket>0){
+        bucket_pool->read(address_bucket,bucket);
+        for(int j=0;j<bucket.size;j++)
+          if(bucket.keys[j]==key)
+            return bucket.address[j];
+        address_bucket=bucket.NextBucket;
+      }
+      return -1;
+    }
+
+     /**
+     * @brief search the registers whose keys are in [begin, end], the
+     * hash doesn't keep the order so every bucket is read once
+     *
+     * @param begin lower bound of searched keys
+     * @param end upper bound of searched keys
+     */
+    std::vector<long> search_by_range(value_key begin, value_key end){
+      std::vector<long> result;
+      forEach([&](const value_key &key, long address){
+        if(!(key<begin) && !(end<key))
+          result.push_back(address);
+      });
+      return result;
+    }
+
+    /**
+     * @brief Visit every register of the index once, in no order
+     *
+     * @tparam Callback callable as void(const T &key, long address)
+     * @param callback function called for each register
+     */
+    template<typename Callback>
+    void forEach(Callback callback){
+      Bucket bucket;
+      for(long i=0;i<(long)directory.size();i++){
+        Bucket primary;
+        bucket_pool->read(directory[i],primary);
+        if(primary.pattern!=i) //the bucket is pointed by many slots, it is read from the first one
+          continue;
+        long address_bucket=directory[i];
+        while(address_bucket>0){
+          bucket_pool->read(address_bucket,bucket);
+          for(int j=0;j<bucket.size;j++)
+            callback(bucket.keys[j],bucket.address[j]);
+          address_bucket=bucket.NextBucket;
+        }
+      }
+    }
+
+    /**
+     * @brief Write back to disk the buckets modified in the buffer pool
+     *
+     */
+    void flush(){
+      if(bucket_pool)
+        bucket_pool->flushAll();
+    }
+
+    /**
+     * @brief Global depth of the directory
+     *
+     * @return int
+     */
+    int depth(){
+      return global_depth;
+    }
+
+    /**
+     * @brief print the keys of each bucket of the directory
+     *
+     */
+    void print(){
+      for(long i=0;i<(long)directory.size();i++){
+        std::cout<<"Bucket's Index "<<i<<std::endl;
+        long address_bucket=directory[i];
+        Bucket bucket;
+        while(address_bucket>0){
+          bucket_pool->read(address_bucket,bucket);
+          for(int j=0;j<bucket.size;j++)
+            std::cout<<bucket.keys[j]<<"/";
+          address_bucket=bucket.NextBucket;
+        }
+        std::cout<<std::endl;
+      }
+    }
+
+  };
+}
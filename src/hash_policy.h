@@ -0,0 +1,85 @@
+/**
+ * @file hash_policy.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Hash policies of the hashing indexes. A policy is a default
+ * constructible type with uint64_t operator()(const T &key) const, the
+ * default one mixes the bits of integers and hashes the bytes of any
+ * other trivially copyable key (e.g. fixed char arrays)
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace bd2{
+
+/**
+ * @brief Finalizer of splitmix64, every bit of the input changes about
+ * half of the output bits, so sequential or strided keys are spread
+ *
+ * @param x value to be mixed
+ * @return uint64_t
+ */
+inline uint64_t mixBits(uint64_t x){
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Hash of integral (and enum) keys
+ *
+ * @tparam T type of the key
+ */
+template<typename T>
+struct IntegerHash{
+    uint64_t operator()(const T &key) const{
+        return mixBits((uint64_t) key);
+    }
+};
+
+/**
+ * @brief Hash of the bytes of a key, the key is read 8 bytes at a time
+ * and each word is mixed into the state. The key shouldn't have padding
+ * bytes, their value isn't defined
+ *
+ * @tparam T trivially copyable type of the key
+ */
+template<typename T>
+struct BytesHash{
+    static_assert(std::is_trivially_copyable<T>::value, "BytesHash: the key has to be trivially copyable");
+
+    uint64_t operator()(const T &key) const{
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&key);
+        uint64_t hash = sizeof(T);
+        size_t i = 0;
+        for (; i + 8 <= sizeof(T); i += 8){
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = mixBits(hash ^ word);
+        }
+        if (i < sizeof(T)){
+            uint64_t word = 0;
+            std::memcpy(&word, bytes + i, sizeof(T) - i);
+            hash = mixBits(hash ^ word);
+        }
+        return hash;
+    }
+};
+
+/**
+ * @brief Hash policy used when the index doesn't get one
+ *
+ * @tparam T type of the key
+ */
+template<typename T>
+struct DefaultHash : std::conditional<std::is_integral<T>::value || std::is_enum<T>::value,
+                                      IntegerHash<T>, BytesHash<T>>::type{
+};
+}
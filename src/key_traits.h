@@ -0,0 +1,185 @@
+/**
+ * @file key_traits.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Key Traits Implementation, the operations of the B+Tree over its
+ * keys: three-way compare, an order preserving 8 bytes prefix and the size
+ * on the page. FixedString<N> is a byte-string key of N bytes that is
+ * stored in the nodes as it is, so char array fields (e.g. city[30]) can
+ * be indexed and compared word at a time on the page bytes
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <ostream>
+#include <algorithm>
+
+namespace bd2{
+
+/**
+ * @brief Load 8 bytes as a big endian word, so the order of the words is
+ * the order of the bytes
+ *
+ * @param bytes first byte, it doesn't need to be aligned
+ * @return uint64_t word
+ */
+inline uint64_t loadBigEndian(const char *bytes){
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+/**
+ * @brief Compare two byte-strings of N bytes as unsigned bytes, 8 bytes
+ * at a time
+ *
+ * @tparam N number of bytes
+ * @return int negative, zero or positive like memcmp
+ */
+template<std::size_t N>
+inline int compareBytes(const char *a, const char *b){
+    std::size_t i = 0;
+    for (; i + 8 <= N; i += 8){
+        uint64_t wa = loadBigEndian(a + i), wb = loadBigEndian(b + i);
+        if (wa != wb)
+            return wa < wb ? -1 : 1;
+    }
+    for (; i < N; i++){
+        unsigned char ca = a[i], cb = b[i];
+        if (ca != cb)
+            return ca < cb ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Byte-string key of N bytes, the bytes after the end of the
+ * string are zero, so the shorter strings are ordered first
+ *
+ * @tparam N number of bytes, e.g. sizeof(Record::city)
+ */
+template<std::size_t N>
+struct FixedString{
+    char data[N];
+
+    FixedString(){
+        std::memset(data, 0, N);
+    }
+
+    FixedString(const char *str){
+        std::size_t len = 0;
+        while (len < N && str[len] != '\0')
+            len++;
+        std::memcpy(data, str, len);
+        std::memset(data + len, 0, N - len); //the key isn't terminated if it fills the N bytes
+    }
+
+    FixedString(const std::string &str) : FixedString(str.c_str()){
+    }
+
+    template<std::size_t M>
+    FixedString(const char (&field)[M]){
+        std::size_t len = std::find(field, field + std::min(M, N), '\0') - field; //the field may not be terminated
+        std::memcpy(data, field, len);
+        std::memset(data + len, 0, N - len);
+    }
+
+    /**
+     * @brief Length of the string, it is at most N
+     */
+    std::size_t size() const{
+        return std::find(data, data + N, '\0') - data;
+    }
+
+    std::string str() const{
+        return std::string(data, size());
+    }
+
+    int compare(const FixedString &other) const{
+        return compareBytes<N>(data, other.data);
+    }
+
+    bool operator<(const FixedString &other) const{ return compare(other) < 0; }
+    bool operator>(const FixedString &other) const{ return compare(other) > 0; }
+    bool operator<=(const FixedString &other) const{ return compare(other) <= 0; }
+    bool operator>=(const FixedString &other) const{ return compare(other) >= 0; }
+    bool operator==(const FixedString &other) const{ return compare(other) == 0; }
+    bool operator!=(const FixedString &other) const{ return compare(other) != 0; }
+};
+
+template<std::size_t N>
+std::ostream& operator<<(std::ostream &out, const FixedString<N> &key){
+    return out.write(key.data, key.size());
+}
+
+/**
+ * @brief Operations of the B+Tree over a key type, general version for
+ * the scalar keys compared with their own operators
+ *
+ * @tparam T type of the key
+ */
+template<typename T>
+struct KeyTraits{
+    static constexpr std::size_t size = sizeof(T); //bytes of the key on the page, PageOrder sizes the nodes with it
+    static constexpr bool has_prefix = false; //NodeSearch compares the 8 bytes prefix first if the keys have one
+
+    static int compare(const T &a, const T &b){
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+};
+
+/**
+ * @brief Operations over byte-string keys, the prefix is the first 8
+ * bytes as a big endian word, if two prefixes are different they give
+ * the order of the keys without reading the rest of the bytes
+ *
+ * @tparam N number of bytes
+ */
+template<std::size_t N>
+struct KeyTraits<FixedString<N>>{
+    static constexpr std::size_t size = N;
+    static constexpr bool has_prefix = true;
+
+    static int compare(const FixedString<N> &a, const FixedString<N> &b){
+        return compareBytes<N>(a.data, b.data);
+    }
+
+    static uint64_t prefix(const FixedString<N> &key){
+        if (N >= 8)
+            return loadBigEndian(key.data);
+        char bytes[8] = {};
+        std::memcpy(bytes, key.data, N < 8 ? N : 8);
+        return loadBigEndian(bytes);
+    }
+
+    /**
+     * @brief Compare the bytes after the prefix, it is used when the
+     * prefixes are equal
+     */
+    static int compareSuffix(const FixedString<N> &a, const FixedString<N> &b){
+        return N > 8 ? compareBytes<(N > 8 ? N - 8 : 0)>(a.data + 8, b.data + 8) : 0;
+    }
+};
+
+template<typename T>
+constexpr std::size_t KeyTraits<T>::size;
+
+template<typename T>
+constexpr bool KeyTraits<T>::has_prefix;
+
+template<std::size_t N>
+constexpr std::size_t KeyTraits<FixedString<N>>::size;
+
+template<std::size_t N>
+constexpr bool KeyTraits<FixedString<N>>::has_prefix;
+}
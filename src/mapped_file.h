@@ -0,0 +1,244 @@
+/**
+ * @file mapped_file.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Memory mapped file, it is the storage of the DiskManager
+ * in mmap mode. The file is grown and mapped in large chunks and
+ * truncated to its real size when it is closed, while it is open the
+ * real size is kept in a trailer at the end of the last chunk, so a file
+ * that wasn't closed (e.g. the process was killed) isn't read with the
+ * padding of the chunk
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include <string>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAPPED_FILE_CHUNK (16L * 1024 * 1024)
+#define MAPPED_FILE_MAGIC 0x4244324d4150454eL //marks the trailer of a file that is open or wasn't closed
+
+namespace bd2{
+
+class MappedFile{
+
+    int fd = -1;
+    char *data = nullptr;
+    long capacity = 0; //bytes mapped, the file has this size while it is open
+    long length = 0; //bytes written by the user
+
+    struct Trailer{
+        long magic;
+        long length;
+    };
+
+    /**
+     * @brief Check if the mapping has room for the trailer after the
+     * bytes written, else the last bytes of the file are data
+     *
+     * @return true the trailer is at the end of the mapping
+     */
+    bool hasTrailer(){
+        return data != nullptr && capacity >= length + (long) sizeof(Trailer);
+    }
+
+    /**
+     * @brief Write the real size of the file to the trailer, it is a
+     * store to the mapping, so it reaches the file like the data
+     *
+     */
+    void storeLength(){
+        if (!hasTrailer())
+            return;
+        Trailer trailer = {MAPPED_FILE_MAGIC, length};
+        std::memcpy(data + capacity - sizeof(Trailer), &trailer, sizeof(Trailer));
+    }
+
+    /**
+     * @brief Real size of a file that wasn't closed, it is read from the
+     * trailer at the end of the file
+     *
+     * @param size bytes of the file
+     * @return long bytes written by the user, size if there is no trailer
+     */
+    long storedLength(long size){
+        Trailer trailer;
+        if (size < (long) sizeof(Trailer) || pread(fd, &trailer, sizeof(Trailer), size - sizeof(Trailer)) != (ssize_t) sizeof(Trailer))
+            return size;
+        if (trailer.magic != MAPPED_FILE_MAGIC || trailer.length < 0 || trailer.length > size - (long) sizeof(Trailer))
+            return size;
+        return trailer.length;
+    }
+
+    /**
+     * @brief Grow the file and the mapping to store at least n bytes and
+     * the trailer
+     *
+     * @param n bytes required
+     * @return true the mapping was grown
+     * @return false an error occurs
+     */
+    bool reserve(long n){
+        n += sizeof(Trailer);
+        if (n <= capacity)
+            return true;
+        if (hasTrailer()) //the old trailer would be read as data
+            std::memset(data + capacity - sizeof(Trailer), 0, sizeof(Trailer));
+        long new_capacity = capacity > 0 ? capacity * 2 : MAPPED_FILE_CHUNK;
+        if (new_capacity < n)
+            new_capacity = n;
+        new_capacity = (new_capacity + MAPPED_FILE_CHUNK - 1) / MAPPED_FILE_CHUNK * MAPPED_FILE_CHUNK;
+        if (ftruncate(fd, new_capacity) != 0)
+            return false;
+        if (!map(new_capacity))
+            return false;
+        storeLength();
+        return true;
+    }
+
+    /**
+     * @brief Replace the current mapping by one of a given size
+     *
+     * @param size bytes to be mapped
+     * @return true successfully mapped
+     * @return false an error occurs
+     */
+    bool map(long size){
+        if (data != nullptr)
+            munmap(data, capacity);
+        data = nullptr;
+        capacity = 0;
+        if (size == 0)
+            return true;
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED)
+            return false;
+        data = static_cast<char *>(ptr);
+        capacity = size;
+        return true;
+    }
+
+public:
+
+    MappedFile(){}
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile& operator=(const MappedFile &) = delete;
+
+    ~MappedFile(){ close(); }
+
+    /**
+     * @brief Open and map a file, it is created if it doesn't exist. If
+     * the file wasn't closed its size is read from the trailer
+     *
+     * @param path filename
+     * @param truncate flag to truncate the file
+     * @return true the file existed and wasn't truncated
+     * @return false the file is empty or it couldn't be opened or mapped
+     */
+    bool open(const std::string &path, bool truncate){
+        fd = ::open(path.data(), O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !map(st.st_size)){
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        length = storedLength(st.st_size);
+        return length > 0;
+    }
+
+    /**
+     * @brief Unmap the file and truncate it to the bytes written
+     *
+     */
+    void close(){
+        if (fd < 0)
+            return;
+        map(0);
+        if (ftruncate(fd, length) != 0)
+            length = 0;
+        ::close(fd);
+        fd = -1;
+    }
+
+    /**
+     * @brief Copy bytes to the file
+     *
+     * @param offset position on the file
+     * @param src bytes to be written
+     * @param n number of bytes
+     * @return true successfully written
+     * @return false an error occurs
+     */
+    bool write(long offset, const void *src, long n){
+        if (!reserve(offset + n))
+            return false;
+        std::memcpy(data + offset, src, n);
+        if (offset + n > length){
+            length = offset + n;
+            storeLength();
+        }
+        return true;
+    }
+
+    /**
+     * @brief Copy bytes from the file
+     *
+     * @param offset position on the file
+     * @param dst buffer to save the read bytes
+     * @param n number of bytes
+     * @return long bytes read
+     */
+    long read(long offset, void *dst, long n){
+        if (offset >= length)
+            return 0;
+        if (offset + n > length)
+            n = length - offset;
+        std::memcpy(dst, data + offset, n);
+        return n;
+    }
+
+    /**
+     * @brief Pointer to the mapped bytes of the file, it is valid until
+     * the next write that grows the file
+     *
+     * @param offset position on the file
+     * @param n number of bytes that have to be mapped
+     * @return const char* pointer to the bytes, nullptr if they are out of the file
+     */
+    const char* borrow(long offset, long n){
+        if (offset < 0 || offset + n > length)
+            return nullptr;
+        return data + offset;
+    }
+
+    /**
+     * @brief Write the modified pages to the file
+     *
+     * @param wait if it returns after the pages are on the device
+     */
+    void sync(bool wait = false){
+        if (data != nullptr)
+            msync(data, capacity, wait ? MS_SYNC : MS_ASYNC);
+        if (wait && fd >= 0)
+            fsync(fd);
+    }
+
+    /**
+     * @brief Bytes written on the file
+     *
+     * @return long
+     */
+    long size(){ return length; }
+};
+}
@@ -0,0 +1,194 @@
+/**
+ * @file node_search.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Search of the position of a key inside a node. The routine is
+ * chosen at compile time: branchless binary search for any key type and
+ * a vectorized compare-and-count for 32/64 bits signed integers when the
+ * code is compiled with AVX2 or SSE4.2 (-mavx2, -msse4.2, -march=native),
+ * the keys with a prefix (KeyTraits<T>::has_prefix), e.g. byte-strings,
+ * are compared first by their 8 bytes prefix
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include "key_traits.h"
+#include <type_traits>
+#include <cstdint>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+#define NODE_SEARCH_WINDOW 32 //keys compared by the count search after the binary steps
+
+namespace bd2{
+
+/**
+ * @brief Branchless binary search, the comparison result is used as an
+ * offset instead of a branch so the loop has no mispredictions
+ *
+ * @tparam T type of the keys
+ * @param keys sorted keys
+ * @param n number of keys
+ * @param val value to be searched
+ * @return int position of the first key not less than val (n if all are less)
+ */
+template<typename T>
+inline int branchlessLowerBound(const T *keys, int n, const T &val){
+    const T *base = keys;
+    while (n > 1){
+        int half = n / 2;
+        base += (base[half - 1] < val) ? half : 0;
+        n -= half;
+    }
+    return (int) (base - keys) + ((n == 1 && *base < val) ? 1 : 0);
+}
+
+/**
+ * @brief Count the keys less than val, for sorted keys it is the
+ * position of the first key not less than val
+ *
+ * @tparam T type of the keys
+ * @param keys sorted keys
+ * @param n number of keys
+ * @param val value to be searched
+ * @return int number of keys less than val
+ */
+template<typename T>
+inline int countLess(const T *keys, int n, const T &val){
+    int count = 0;
+    for (int i = 0; i < n; i++)
+        count += keys[i] < val;
+    return count;
+}
+
+#if defined(__AVX2__)
+inline int countLess(const int32_t *keys, int n, const int32_t &val){
+    __m256i value = _mm256_set1_epi32(val);
+    int count = 0, i = 0;
+    for (; i + 8 <= n; i += 8){
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+        __m256i less = _mm256_cmpgt_epi32(value, block);
+        count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+    }
+    for (; i < n; i++)
+        count += keys[i] < val;
+    return count;
+}
+
+inline int countLess(const int64_t *keys, int n, const int64_t &val){
+    __m256i value = _mm256_set1_epi64x(val);
+    int count = 0, i = 0;
+    for (; i + 4 <= n; i += 4){
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+        __m256i less = _mm256_cmpgt_epi64(value, block);
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(less)));
+    }
+    for (; i < n; i++)
+        count += keys[i] < val;
+    return count;
+}
+#elif defined(__SSE4_2__)
+inline int countLess(const int32_t *keys, int n, const int32_t &val){
+    __m128i value = _mm_set1_epi32(val);
+    int count = 0, i = 0;
+    for (; i + 4 <= n; i += 4){
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+        __m128i less = _mm_cmpgt_epi32(value, block);
+        count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
+    }
+    for (; i < n; i++)
+        count += keys[i] < val;
+    return count;
+}
+
+inline int countLess(const int64_t *keys, int n, const int64_t &val){
+    __m128i value = _mm_set1_epi64x(val);
+    int count = 0, i = 0;
+    for (; i + 2 <= n; i += 2){
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+        __m128i less = _mm_cmpgt_epi64(value, block);
+        count += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(less)));
+    }
+    for (; i < n; i++)
+        count += keys[i] < val;
+    return count;
+}
+#endif
+
+/**
+ * @brief Key search inside a node, general version: branchless binary search
+ *
+ * @tparam T type of the keys
+ * @tparam ORDER order of the btree
+ */
+template<typename T, int ORDER, typename Enable = void>
+struct NodeSearch{
+    static int lowerBound(const T *keys, int n, const T &val){
+        return branchlessLowerBound(keys, n, val);
+    }
+};
+
+/**
+ * @brief Key search inside a node for 32/64 bits signed integers: binary
+ * steps until NODE_SEARCH_WINDOW keys remain and then a compare-and-count
+ * over them, which is vectorized when AVX2/SSE4.2 is available
+ *
+ * @tparam T type of the keys
+ * @tparam ORDER order of the btree
+ */
+template<typename T, int ORDER>
+struct NodeSearch<T, ORDER, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value &&
+                                                    (sizeof(T) == 4 || sizeof(T) == 8)>::type>{
+
+    using word = typename std::conditional<sizeof(T) == 4, int32_t, int64_t>::type;
+
+    static int lowerBound(const T *keys, int n, const T &val){
+        const T *base = keys;
+        if (ORDER > NODE_SEARCH_WINDOW){
+            while (n > NODE_SEARCH_WINDOW){
+                int half = n / 2;
+                base += (base[half - 1] < val) ? half : 0;
+                n -= half;
+            }
+        }
+        return (int) (base - keys) + countLess(reinterpret_cast<const word *>(base), n, (word) val);
+    }
+};
+
+/**
+ * @brief Key search inside a node for keys with an order preserving
+ * prefix, e.g. byte-strings: branchless binary search over the keys of
+ * the page, the prefix of the probed key decides the step and the rest
+ * of the bytes are only compared when the prefixes are equal
+ *
+ * @tparam T type of the keys, KeyTraits<T>::has_prefix is true
+ * @tparam ORDER order of the btree
+ */
+template<typename T, int ORDER>
+struct NodeSearch<T, ORDER, typename std::enable_if<KeyTraits<T>::has_prefix>::type>{
+
+    using traits = KeyTraits<T>;
+
+    static bool less(const T &key, uint64_t val_prefix, const T &val){
+        uint64_t key_prefix = traits::prefix(key);
+        if (key_prefix != val_prefix)
+            return key_prefix < val_prefix;
+        return traits::compareSuffix(key, val) < 0;
+    }
+
+    static int lowerBound(const T *keys, int n, const T &val){
+        uint64_t val_prefix = traits::prefix(val);
+        const T *base = keys;
+        while (n > 1){
+            int half = n / 2;
+            base += less(base[half - 1], val_prefix, val) ? half : 0;
+            n -= half;
+        }
+        return (int) (base - keys) + ((n == 1 && less(*base, val_prefix, val)) ? 1 : 0);
+    }
+};
+}
@@ -0,0 +1,137 @@
+/**
+ * @file page_allocator.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Page Allocator Implementation, it hands out the pages of a file
+ * and keeps the released ones in a persistent free list, the state is
+ * stored in the header at the start of the file
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include "disk_manager.h"
+#include "buffer_pool.h"
+#include <memory>
+#include <mutex>
+
+namespace bd2{
+
+/**
+ * @brief Allocator of the pages of a file, it is shared by the index
+ * structures (B+Tree nodes, hashing buckets). The released pages are
+ * linked through the pages themselves, so Page has to provide
+ * nextFreePage() and linkFreePage(long)
+ *
+ * @tparam Page type of the page stored in the file
+ */
+template<typename Page>
+class PageAllocator{
+
+    using diskManager = std::shared_ptr<DiskManager>;
+    using bufferPool = std::shared_ptr<BufferPool<Page>>;
+
+    //header stored at the start of the file, in the space of the page 0
+    struct Header{
+        long n_pages = 0; //pages of the file, including the reserved ones
+        long free_list = 0; //first released page, 0 means there are no released pages
+    } header;
+
+    static_assert(sizeof(Page) >= sizeof(Header), "PageAllocator: the header doesn't fit in the page 0");
+
+    diskManager disk_manager;
+    bufferPool buffer_pool;
+    std::mutex latch;
+
+    /**
+     * @brief Write the header to disk
+     *
+     */
+    void writeHeader(){
+        disk_manager->write_record(0, header);
+    }
+
+public:
+
+    /**
+     * @brief Construct a new Page Allocator object, if the file is empty the
+     * first reserved_pages pages are taken (the page 0 is always reserved
+     * for the header), else the header is read from the file
+     *
+     * @param manager disk manager of the file
+     * @param pool buffer pool of the file
+     * @param reserved_pages pages at the start of the file that aren't allocated
+     */
+    PageAllocator(diskManager manager, bufferPool pool, long reserved_pages = 1){
+        disk_manager = manager;
+        buffer_pool = pool;
+        if (disk_manager->is_empty() || !disk_manager->retrieve_record(0, header)){
+            header.n_pages = reserved_pages > 1 ? reserved_pages : 1;
+            header.free_list = 0;
+            writeHeader();
+        }
+    }
+
+    /**
+     * @brief Get a page, a released page if exists, else a new one at the end
+     *
+     * @return long position of the page
+     */
+    long allocate(){
+        std::lock_guard<std::mutex> lock(latch);
+        long page_id;
+        if (header.free_list > 0){
+            page_id = header.free_list;
+            header.free_list = buffer_pool->pin(page_id).nextFreePage(); //the page isn't copied
+            buffer_pool->unpin(page_id, false);
+        } else {
+            page_id = header.n_pages++;
+        }
+        writeHeader();
+        return page_id;
+    }
+
+    /**
+     * @brief Release a page, it is linked to the free list and reused by
+     * the next allocation. The link is written to the file before the
+     * header, so the header never points to a page whose link isn't on
+     * the file (with a write-ahead log both are in the same group or the
+     * link is in an earlier one)
+     *
+     * @param page_id position of the page
+     */
+    void release(long page_id){
+        std::lock_guard<std::mutex> lock(latch);
+        buffer_pool->pinNew(page_id).linkFreePage(header.free_list); //only the link is written
+        buffer_pool->unpin(page_id, true);
+        buffer_pool->flush(page_id);
+        header.free_list = page_id;
+        writeHeader();
+    }
+
+    /**
+     * @brief Set the number of pages of the file and drop the free list,
+     * it is used when the file was rewritten (e.g. a bulk load)
+     *
+     * @param n_pages pages of the file
+     */
+    void reset(long n_pages){
+        std::lock_guard<std::mutex> lock(latch);
+        header.n_pages = n_pages;
+        header.free_list = 0;
+        writeHeader();
+    }
+
+    /**
+     * @brief Number of pages of the file
+     *
+     * @return long
+     */
+    long size(){
+        std::lock_guard<std::mutex> lock(latch);
+        return header.n_pages;
+    }
+};
+}
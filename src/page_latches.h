@@ -0,0 +1,83 @@
+/**
+ * @file page_latches.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Reader/writer latches of the pages of a file, one latch per page.
+ * The latches are allocated in chunks the first time a page of the chunk
+ * is latched, so the lookup of a latch doesn't take a global lock
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+
+#define PAGE_LATCH_CHUNK 1024 //latches allocated at once
+#define PAGE_LATCH_CHUNKS 4096 //max number of chunks, 4M pages
+
+namespace bd2{
+
+class PageLatches{
+
+    using latch = std::shared_timed_mutex;
+
+    struct Chunk{
+        latch latches[PAGE_LATCH_CHUNK];
+    };
+
+    std::unique_ptr<std::atomic<Chunk *>[]> directory;
+    std::mutex grow_latch; //protects the allocation of the chunks
+
+public:
+
+    PageLatches() : directory(new std::atomic<Chunk *>[PAGE_LATCH_CHUNKS]){
+        for (int i = 0; i < PAGE_LATCH_CHUNKS; i++)
+            directory[i].store(nullptr);
+    }
+
+    PageLatches(const PageLatches &) = delete;
+    PageLatches& operator=(const PageLatches &) = delete;
+
+    ~PageLatches(){
+        for (int i = 0; i < PAGE_LATCH_CHUNKS; i++)
+            delete directory[i].load();
+    }
+
+    /**
+     * @brief Latch of a page, two different pages never share a latch so
+     * a thread can hold the latches of many pages at once
+     *
+     * @param page_id position of the page on disk
+     * @return latch& latch of the page
+     */
+    latch& get(long page_id){
+        long pos = page_id / PAGE_LATCH_CHUNK;
+        if (page_id < 0 || pos >= PAGE_LATCH_CHUNKS)
+            throw std::runtime_error("PageLatches: page out of range");
+        Chunk *chunk = directory[pos].load(std::memory_order_acquire);
+        if (chunk == nullptr){
+            std::lock_guard<std::mutex> lock(grow_latch);
+            chunk = directory[pos].load(std::memory_order_acquire);
+            if (chunk == nullptr){
+                chunk = new Chunk();
+                directory[pos].store(chunk, std::memory_order_release);
+            }
+        }
+        return chunk->latches[page_id % PAGE_LATCH_CHUNK];
+    }
+
+    void lockShared(long page_id){ get(page_id).lock_shared(); }
+
+    void unlockShared(long page_id){ get(page_id).unlock_shared(); }
+
+    void lockExclusive(long page_id){ get(page_id).lock(); }
+
+    void unlockExclusive(long page_id){ get(page_id).unlock(); }
+};
+}
@@ -0,0 +1,169 @@
+/**
+ * @file positional_file.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief File accessed with positional pread/pwrite, it is the storage
+ * of the DiskManager in positional mode. There is no shared cursor, so
+ * many threads can read and write the same file at once
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include <string>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bd2{
+
+class PositionalFile{
+
+    int fd = -1;
+    std::atomic<long> length{0}; //bytes of the file
+
+    /**
+     * @brief Update the length of the file after a write
+     *
+     * @param end last byte written
+     */
+    void extend(long end){
+        long current = length.load();
+        while (current < end && !length.compare_exchange_weak(current, end));
+    }
+
+public:
+
+    PositionalFile(){}
+
+    PositionalFile(const PositionalFile &) = delete;
+    PositionalFile& operator=(const PositionalFile &) = delete;
+
+    ~PositionalFile(){ close(); }
+
+    /**
+     * @brief Open a file, it is created if it doesn't exist
+     *
+     * @param path filename
+     * @param truncate flag to truncate the file
+     * @return true the file existed and wasn't truncated
+     * @return false the file is empty
+     */
+    bool open(const std::string &path, bool truncate){
+        fd = ::open(path.data(), O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        fstat(fd, &st);
+        length = st.st_size;
+        return length > 0;
+    }
+
+    /**
+     * @brief Close the file
+     *
+     */
+    void close(){
+        if (fd < 0)
+            return;
+        ::close(fd);
+        fd = -1;
+    }
+
+    /**
+     * @brief Write bytes at a given position of the file
+     *
+     * @param offset position on the file
+     * @param src bytes to be written
+     * @param n number of bytes
+     * @return true successfully written
+     * @return false an error occurs
+     */
+    bool write(long offset, const void *src, long n){
+        const char *bytes = static_cast<const char *>(src);
+        long done = 0;
+        while (done < n){
+            ssize_t written = pwrite(fd, bytes + done, n - done, offset + done);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            done += written;
+        }
+        extend(offset + n);
+        return true;
+    }
+
+    /**
+     * @brief Reserve space at the end of the file and write bytes on it,
+     * concurrent appends get different positions
+     *
+     * @param src bytes to be written
+     * @param n number of bytes
+     * @return long position in which the bytes were written, -1 if an error occurs
+     */
+    long append(const void *src, long n){
+        long offset = length.fetch_add(n);
+        if (write(offset, src, n))
+            return offset;
+        long end = offset + n;
+        length.compare_exchange_strong(end, offset); //give back the space if no other append reserved after it
+        return -1;
+    }
+
+    /**
+     * @brief Read bytes from a given position of the file
+     *
+     * @param offset position on the file
+     * @param dst buffer to save the read bytes
+     * @param n number of bytes
+     * @return long bytes read
+     */
+    long read(long offset, void *dst, long n){
+        char *bytes = static_cast<char *>(dst);
+        long done = 0;
+        while (done < n){
+            ssize_t got = pread(fd, bytes + done, n - done, offset + done);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                break;
+            done += got;
+        }
+        return done;
+    }
+
+    /**
+     * @brief Write the file to the device
+     *
+     */
+    void sync(){
+        if (fd >= 0)
+            fdatasync(fd);
+    }
+
+    /**
+     * @brief Cut the file to a given size
+     *
+     * @param n bytes that are kept
+     * @return true successfully truncated
+     */
+    bool truncate(long n){
+        if (fd < 0 || ftruncate(fd, n) != 0)
+            return false;
+        length = n;
+        return true;
+    }
+
+    /**
+     * @brief Bytes of the file
+     *
+     * @return long
+     */
+    long size(){ return length.load(); }
+};
+}
@@ -0,0 +1,162 @@
+/**
+ * @file record_predicate.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Predicates over the fields of a Record, they are used by the
+ * scans of the data file to filter on fields without index. A field is
+ * described at compile time by its pointer to member, e.g.
+ * BD2_FIELD(Default, city), the char arrays are compared as strings
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include <string>
+#include <cstring>
+#include <cstddef>
+
+//descriptor of the field member of the type Record
+#define BD2_FIELD(Record, member) bd2::Field<Record, decltype(Record::member), &Record::member>
+
+namespace bd2{
+
+/**
+ * @brief Value used to compare a field, the char arrays are compared
+ * with strings and the other fields with their own type
+ *
+ * @tparam FieldType type of the field
+ */
+template<typename FieldType>
+struct FieldValue{
+    using type = FieldType;
+
+    static int compare(const FieldType &field, const type &value){
+        return field < value ? -1 : (value < field ? 1 : 0);
+    }
+};
+
+template<std::size_t N>
+struct FieldValue<char[N]>{
+    using type = std::string;
+
+    /**
+     * @brief Compare the string of the field, it may not be terminated
+     */
+    static int compare(const char (&field)[N], const type &value){
+        return std::strncmp(field, value.c_str(), N);
+    }
+
+    /**
+     * @brief Check if the string of the field starts with a prefix
+     */
+    static bool startsWith(const char (&field)[N], const type &prefix){
+        return prefix.size() <= N && std::strncmp(field, prefix.c_str(), prefix.size()) == 0;
+    }
+};
+
+/**
+ * @brief Field of a Record at a fixed offset
+ *
+ * @tparam Record class stored in the data file
+ * @tparam FieldType type of the field
+ * @tparam Member pointer to the field
+ */
+template<typename Record, typename FieldType, FieldType Record::*Member>
+struct Field{
+    using type = FieldType;
+    using value = typename FieldValue<FieldType>::type;
+
+    static const FieldType& get(const Record &record){
+        return record.*Member;
+    }
+
+    static int compare(const Record &record, const value &v){
+        return FieldValue<FieldType>::compare(get(record), v);
+    }
+};
+
+/**
+ * @brief The field is equal to a value
+ *
+ * @tparam F field descriptor
+ */
+template<typename F>
+struct Equals{
+    typename F::value target;
+
+    template<typename Record>
+    bool operator()(const Record &record) const{
+        return F::compare(record, target) == 0;
+    }
+};
+
+/**
+ * @brief The field is in [first, last]
+ *
+ * @tparam F field descriptor
+ */
+template<typename F>
+struct Between{
+    typename F::value first;
+    typename F::value last;
+
+    template<typename Record>
+    bool operator()(const Record &record) const{
+        return F::compare(record, first) >= 0 && F::compare(record, last) <= 0;
+    }
+};
+
+/**
+ * @brief The string of a char array field starts with a prefix
+ *
+ * @tparam F field descriptor
+ */
+template<typename F>
+struct Prefix{
+    std::string prefix;
+
+    template<typename Record>
+    bool operator()(const Record &record) const{
+        return FieldValue<typename F::type>::startsWith(F::get(record), prefix);
+    }
+};
+
+/**
+ * @brief Both predicates are true
+ *
+ * @tparam P1 first predicate
+ * @tparam P2 second predicate
+ */
+template<typename P1, typename P2>
+struct And{
+    P1 first;
+    P2 second;
+
+    template<typename Record>
+    bool operator()(const Record &record) const{
+        return first(record) && second(record);
+    }
+};
+
+template<typename F>
+Equals<F> equals(const typename F::value &target){
+    return Equals<F>{target};
+}
+
+template<typename F>
+Between<F> between(const typename F::value &first, const typename F::value &last){
+    return Between<F>{first, last};
+}
+
+template<typename F>
+Prefix<F> prefix(const std::string &prefix){
+    return Prefix<F>{prefix};
+}
+
+template<typename P1, typename P2>
+And<P1, P2> both(const P1 &first, const P2 &second){
+    return And<P1, P2>{first, second};
+}
+}
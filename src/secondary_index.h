@@ -0,0 +1,284 @@
+/**
+ * @file secondary_index.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Secondary Index Implementation, a B+Tree over a non-primary field
+ * of the Record. The field can have repeated values, so the tree is keyed
+ * by (value, record id) and the keys stay unique
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include "b_plus_tree.h"
+#include "record_predicate.h"
+#include "key_traits.h"
+#include <memory>
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+
+namespace bd2{
+
+/**
+ * @brief Copy of a field stored in the keys of a secondary index
+ *
+ * @tparam FieldType type of the field
+ */
+template<typename FieldType>
+struct IndexedValue{
+    using type = FieldType;
+
+    static void assign(type &dst, const FieldType &src){
+        dst = src;
+    }
+
+    static int compare(const type &a, const type &b){
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+};
+
+template<std::size_t N>
+struct IndexedValue<char[N]>{
+    using type = FixedString<N>;
+
+    static void assign(type &dst, const char (&src)[N]){
+        dst = type(src);
+    }
+
+    static void assign(type &dst, const std::string &src){
+        dst = type(src);
+    }
+
+    static int compare(const type &a, const type &b){
+        return KeyTraits<type>::compare(a, b);
+    }
+};
+
+/**
+ * @brief Key of a secondary index, the values are ordered by the field
+ * and the repeated ones by record id
+ *
+ * @tparam FieldType type of the field
+ */
+template<typename FieldType>
+struct SecondaryKey{
+    using indexed = IndexedValue<FieldType>;
+
+    typename indexed::type value;
+    long record_id;
+
+    int compare(const SecondaryKey &other) const{
+        int cmp = indexed::compare(value, other.value);
+        if (cmp != 0)
+            return cmp;
+        return record_id < other.record_id ? -1 : (other.record_id < record_id ? 1 : 0);
+    }
+
+    bool operator<(const SecondaryKey &other) const{ return compare(other) < 0; }
+    bool operator>(const SecondaryKey &other) const{ return compare(other) > 0; }
+    bool operator==(const SecondaryKey &other) const{ return compare(other) == 0; }
+    bool operator!=(const SecondaryKey &other) const{ return compare(other) != 0; }
+};
+
+/**
+ * @brief Interface used by DataBase to maintain its secondary indexes
+ *
+ * @tparam Record class stored in the data file
+ */
+template<typename Record>
+class SecondaryIndexBase{
+public:
+    virtual ~SecondaryIndexBase(){}
+
+    /**
+     * @brief Add a record to the index
+     *
+     * @param record record inserted
+     * @param record_id position of the record on the data file
+     */
+    virtual void insert(const Record &record, long record_id) = 0;
+
+    /**
+     * @brief Remove a record of the index
+     *
+     * @param record record erased
+     * @param record_id position of the record on the data file
+     * @return true the record was indexed
+     */
+    virtual bool erase(const Record &record, long record_id) = 0;
+
+    /**
+     * @brief Write back to disk the nodes modified in the buffer pool
+     *
+     */
+    virtual void flush() = 0;
+
+    /**
+     * @brief Disk manager of the index file
+     *
+     * @return std::shared_ptr<DiskManager>
+     */
+    virtual std::shared_ptr<DiskManager> file() = 0;
+
+    /**
+     * @brief Read the index again, it is used after the file was recovered
+     *
+     */
+    virtual void reload() = 0;
+};
+
+/**
+ * @brief Secondary index over the field F of a Record
+ *
+ * @tparam Record class stored in the data file
+ * @tparam F field descriptor, e.g. BD2_FIELD(Default, city)
+ * @tparam PAGE_SIZE size of the nodes on disk
+ */
+template<typename Record, typename F, std::size_t PAGE_SIZE = NODE_PAGE_SIZE>
+class SecondaryIndex : public SecondaryIndexBase<Record>{
+
+    using field = typename F::type;
+    using key = SecondaryKey<field>;
+    using indexed = IndexedValue<field>;
+    using btree = BPlusTree<key, PageOrder<key, PAGE_SIZE>::value>;
+    using diskManager = std::shared_ptr<DiskManager>;
+
+public:
+    using entry = std::pair<key, long>;
+
+private:
+    diskManager disk_manager;
+    btree tree;
+
+    /**
+     * @brief Key of a record
+     */
+    static key makeKey(const Record &record, long record_id){
+        key k;
+        indexed::assign(k.value, F::get(record));
+        k.record_id = record_id;
+        return k;
+    }
+
+    /**
+     * @brief Key of a value, it is the first or last key of the value
+     */
+    template<typename Value>
+    static key makeBound(const Value &value, long record_id){
+        key k;
+        indexed::assign(k.value, value);
+        k.record_id = record_id;
+        return k;
+    }
+
+public:
+
+    /**
+     * @brief Construct a new Secondary Index object
+     *
+     * @param manager disk manager of the index file
+     */
+    SecondaryIndex(diskManager manager) : disk_manager(manager), tree(manager){
+    }
+
+    void insert(const Record &record, long record_id) override{
+        tree.insert(makeKey(record, record_id), record_id);
+    }
+
+    bool erase(const Record &record, long record_id) override{
+        return tree.erase(makeKey(record, record_id));
+    }
+
+    void flush() override{
+        tree.flush();
+    }
+
+    diskManager file() override{
+        return disk_manager;
+    }
+
+    void reload() override{
+        tree = btree(disk_manager);
+    }
+
+    /**
+     * @brief Entry of the bulk load of a record, it only keeps the field
+     * and the record id, not the whole record
+     *
+     * @param record record to be indexed
+     * @param record_id position of the record on the data file
+     * @return entry (key, record id)
+     */
+    static entry makeEntry(const Record &record, long record_id){
+        return std::make_pair(makeKey(record, record_id), record_id);
+    }
+
+    /**
+     * @brief Build the index of an empty file with a bulk load
+     *
+     * @param entries (key, record id) of the records, see makeEntry, they
+     * are sorted in place
+     * @return true the index was empty and it was built
+     */
+    bool build(std::vector<entry> &entries){
+        std::sort(entries.begin(), entries.end(),
+                  [](const entry &a, const entry &b){
+                      return a.first < b.first;
+                  });
+        return tree.bulkLoad(entries.begin(), entries.end());
+    }
+
+    /**
+     * @brief Stream the record ids whose field is in [first, last], in
+     * order of the field
+     *
+     * @tparam Callback callable as bool(long record_id), it returns false
+     * to stop the scan
+     * @param first first value of the field
+     * @param last last value of the field
+     * @param callback function called for each record
+     * @param limit max records to be visited, -1 without limit
+     * @return long number of records visited
+     */
+    template<typename Value, typename Callback>
+    long scan(const Value &first, const Value &last, Callback callback, long limit = -1){
+        return tree.range_scan(makeBound(first, std::numeric_limits<long>::min()),
+                               makeBound(last, std::numeric_limits<long>::max()),
+                               [&callback](const key &, long record_id){
+                                   return (bool) callback(record_id);
+                               }, limit);
+    }
+
+    /**
+     * @brief Record ids whose field is in [first, last]
+     *
+     * @param first first value of the field
+     * @param last last value of the field
+     * @return std::vector<long> record ids in order of the field
+     */
+    template<typename Value>
+    std::vector<long> search_by_range(const Value &first, const Value &last){
+        std::vector<long> result;
+        scan(first, last, [&result](long record_id){
+            result.push_back(record_id);
+            return true;
+        });
+        return result;
+    }
+
+    /**
+     * @brief Record ids whose field is equal to a value
+     *
+     * @param value value of the field
+     * @return std::vector<long> record ids
+     */
+    template<typename Value>
+    std::vector<long> search(const Value &value){
+        return search_by_range(value, value);
+    }
+};
+}
@@ -11,9 +11,13 @@
 
  #pragma once
 #include "disk_manager.h"
+#include "buffer_pool.h"
+#include "page_allocator.h"
+#include "hash_policy.h"
 #include<memory>
 #include<queue>
 #include<vector>
+#include<type_traits>
 #include<iostream>
 
 
@@ -37,6 +41,40 @@ namespace bd2{
         NextBucket=-1;
         size=0;
       }
+
+      /**
+       * @brief Next bucket of the free list, if the bucket was released
+       *
+       * @return long
+       */
+      long nextFreePage() const{
+        return NextBucket;
+      }
+
+      /**
+       * @brief Link a released bucket to the free list
+       *
+       * @param next next bucket of the free list
+       */
+      void linkFreePage(long next){
+        size=0;
+        NextBucket=next;
+      }
+  };
+
+/**
+ * @brief Load of the buckets of a hashing index
+ *
+ */
+  struct BucketLoad{
+    long n_buckets = 0; //primary buckets
+    long n_records = 0;
+    long n_overflow = 0; //overflow buckets in the chains
+    long empty_buckets = 0; //primary buckets without records
+    long max_chain = 0; //buckets of the longest chain
+    long max_records = 0; //records of the most loaded bucket
+    long max_hash = -1; //hash of the most loaded bucket
+    std::vector<long> chains; //number of primary buckets by chain length
   };
 
 /**
@@ -45,25 +83,107 @@ namespace bd2{
  * @tparam T type of the key value
  * @tparam gd global depth in Index
  * @tparam fd max size in each Bucket's object
+ * @tparam Hash hash policy, see hash_policy.h
  */
-  template<typename T,int gd,int fd>
+  template<typename T,int gd,int fd,typename Hash = DefaultHash<T>>
   class StaticHashing{
 
     using page = std::shared_ptr<DiskManager>; 
     using value_key = T;
     using Bucket = Bucket_S<T,fd>;
+    using bucketPool = std::shared_ptr<BufferPool<Bucket>>;
+    using bucketAllocator = std::shared_ptr<PageAllocator<Bucket>>;
 
     page control_bucket;
     page control_data;
+    bucketPool bucket_pool; //cache of the buckets file
+    bucketAllocator allocator; //allocator of the overflow buckets
+
+    /**
+     * @brief Position on disk of the first bucket of a hash, the page 0
+     * keeps the header of the allocator
+     *
+     * @param hash hash of the key
+     * @return long position of the bucket
+     */
+    long primaryAddress(long hash){
+      return hash+1;
+    }
+
+    /**
+     * @brief Append the registers of a chain whose keys are in [begin, end]
+     *
+     * @param hash hash of the chain
+     * @param begin lower bound of searched keys
+     * @param end upper bound of searched keys
+     * @param result addresses of the registers found
+     */
+    void searchChain(long hash, const value_key &begin, const value_key &end, std::vector<long> &result){
+      long address_bucket=primaryAddress(hash);
+      Bucket bucket;
+      bucket_pool->read(address_bucket,bucket);
+      while(true){
+        for(int j=0;j<bucket.size;j++)
+          if(!(bucket.keys[j]<begin) && !(end<bucket.keys[j]))
+            result.push_back(bucket.address[j]);
+        if(bucket.NextBucket<=0)
+          break;
+        bucket_pool->read(bucket.NextBucket,bucket);
+      }
+    }
+
+    /**
+     * @brief Read every chain once, it is a full scan of the index: the
+     * hash policy mixes the keys, so every chain holds keys from the
+     * whole key space and no chain can be skipped by its keys
+     *
+     */
+    void scanChains(const value_key &begin, const value_key &end, std::vector<long> &result){
+      for(long i=0;i<(long)gd;i++)
+        searchChain(i,begin,end,result);
+    }
+
+    /**
+     * @brief Range of integral keys, the chains of the keys are probed if
+     * the range is narrower than the directory, otherwise the chains are scanned
+     *
+     */
+    void searchRange(const value_key &begin, const value_key &end, std::vector<long> &result, std::true_type){
+      uint64_t width=(uint64_t)end-(uint64_t)begin;
+      if(width>=(uint64_t)gd){
+        scanChains(begin,end,result);
+        return;
+      }
+      std::vector<bool> probed(gd,false); //keys with the same hash share the chain
+      for(value_key i=begin;;i++){
+        long hash=getHash(i);
+        if(!probed[hash]){
+          probed[hash]=true;
+          searchChain(hash,begin,end,result);
+        }
+        if(i==end)
+          break;
+      }
+    }
+
+    /**
+     * @brief Range of keys that can't be enumerated, the chains are scanned
+     *
+     */
+    void searchRange(const value_key &begin, const value_key &end, std::vector<long> &result, std::false_type){
+      scanChains(begin,end,result);
+    }
 
     public:
     StaticHashing(){
     }
 
-    StaticHashing(page c_bucket, page c_data){
+    StaticHashing(page c_bucket, page c_data, int pool_capacity = BUFFER_POOL_PAGES){
 
       control_bucket = c_bucket;
       control_data = c_data;
+      bucket_pool = std::make_shared<BufferPool<Bucket>>(control_bucket, pool_capacity);
+      allocator = std::make_shared<PageAllocator<Bucket>>(control_bucket, bucket_pool, gd+1); //the primary buckets are reserved
 
     }
     ~StaticHashing(){
@@ -71,12 +191,13 @@ namespace bd2{
 
 
    /**
-     * @brief convert key value to hash repesctivily 
+     * @brief convert key value to hash repesctivily, the hash policy mixes
+     * the key so sequential or strided keys don't cluster in few buckets
      *
      * @param key key's value of the register
      */
     long getHash(value_key key){
-      long hash=(long)key%gd;
+      long hash=(long)(Hash()(key)%(uint64_t)gd);
       //transform key to hash
       return hash;
     }
@@ -91,43 +212,73 @@ namespace bd2{
 
 
       long hash=getHash(key);
-      long address_bucket=hash;
+      long address_bucket=primaryAddress(hash);
 
       Bucket bucket;
-
-      do{
-        control_bucket->retrieve_record(address_bucket,bucket);
-        if(bucket.NextBucket>0)
-          address_bucket=bucket.NextBucket;
+      bucket_pool->read(address_bucket,bucket);
+      while(bucket.NextBucket>0){
+        address_bucket=bucket.NextBucket;
+        bucket_pool->read(address_bucket,bucket);
       }
-      while(bucket.NextBucket>0);
 
       if(bucket.size==fd){
         Bucket new_bucket;
         new_bucket.address[0]=address_register;
         new_bucket.keys[0]=key;
         new_bucket.size=1;
-        long pos= control_bucket->write_record_to_ending(new_bucket);
+        long pos= allocator->allocate(); //a released bucket is reused if exists
+        bucket_pool->write(pos,new_bucket);
         bucket.NextBucket=pos;
-        control_bucket->write_record(address_bucket,bucket);
       }
       else{
         bucket.address[bucket.size]=address_register;
         bucket.keys[bucket.size]=key;
         bucket.size++;
-        control_bucket->write_record(address_bucket,bucket);
       }
+      bucket_pool->write(address_bucket,bucket);
     }
-     /**
-     * @brief generate a next value for an specific sort of value in key, return this next value
+    /**
+     * @brief erase a register of the index, an overflow bucket that gets
+     * empty is unlinked of its chain and released to be reused
      *
-     * @param value value of key 
+     * @param key value of key to be erased
+     * @return true the key was erased
+     * @return false the key doesn't exist
      */
-    value_key next_value(value_key value){
-      value_key t;
-      t=value+1;
-      //next_
-      return t;
+    bool erase(value_key key){
+      long primary_address=primaryAddress(getHash(key));
+      long address_bucket=primary_address;
+      long prev_address=-1;
+      Bucket bucket, prev;
+      while(address_bucket>0){
+        bucket_pool->read(address_bucket,bucket);
+        for(int j=0;j<bucket.size;j++){
+          if(bucket.keys[j]!=key)
+            continue;
+          bucket.size--;
+          bucket.keys[j]=bucket.keys[bucket.size];
+          bucket.address[j]=bucket.address[bucket.size];
+          if(bucket.size==0 && prev_address!=-1){ //empty overflow bucket
+            prev.NextBucket=bucket.NextBucket;
+            bucket_pool->write(prev_address,prev);
+            allocator->release(address_bucket);
+          }
+          else if(bucket.size==0 && bucket.NextBucket>0){ //empty primary bucket, the next one takes its place
+            long next=bucket.NextBucket;
+            Bucket next_bucket;
+            bucket_pool->read(next,next_bucket);
+            bucket_pool->write(address_bucket,next_bucket);
+            allocator->release(next);
+          }
+          else
+            bucket_pool->write(address_bucket,bucket);
+          return true;
+        }
+        prev=bucket;
+        prev_address=address_bucket;
+        address_bucket=bucket.NextBucket;
+      }
+      return false;
     }
 
      /**
@@ -137,11 +288,11 @@ namespace bd2{
      */
     long search(value_key key){
       long hash=getHash(key);
-      long address_bucket=hash;
+      long address_bucket=primaryAddress(hash);
       int disk_accesses=0;
       Bucket bucket;
       do{
-        control_bucket->retrieve_record(address_bucket,bucket);
+        bucket_pool->read(address_bucket,bucket);
         disk_accesses++;
         for(int j=0;j<bucket.size;j++){
           if(bucket.keys[j]==key){
@@ -156,28 +307,98 @@ namespace bd2{
       return -1;
     }
      /**
-     * @brief search for a set of values what register exists and return the registers' address
+     * @brief search the registers whose keys are in [begin, end], the cost
+     * is bounded by the directory size instead of the width of the range:
+     * a range of integral keys narrower than the directory probes the
+     * chains of its keys, any other range is a full scan of the chains
      *
      * @param begin lower bound of searched keys
      * @param end upper bound of searched keys
      */
     std::vector<long> search_by_range(value_key begin, value_key end){
       std::vector<long> result;
-      for(value_key i=begin;;i=next_value(i)){
-        long hash=getHash(i);
-        long address_bucket=hash;
-        Bucket bucket;
-        do{
-          control_bucket->retrieve_record(address_bucket,bucket);
-          address_bucket=bucket.NextBucket;
+      if(!(end<begin))
+        searchRange(begin,end,result,std::is_integral<value_key>());
+      return result;
+    }
+
+    /**
+     * @brief Visit every register of the index once, in no order
+     *
+     * @tparam Callback callable as void(const T &key, long address)
+     * @param callback function called for each register
+     */
+    template<typename Callback>
+    void forEach(Callback callback){
+      Bucket bucket;
+      for(long i=0;i<(long)gd;i++){
+        long address_bucket=primaryAddress(i);
+        while(address_bucket>0){
+          bucket_pool->read(address_bucket,bucket);
           for(int j=0;j<bucket.size;j++)
-            result.push_back(bucket.address[j]);
+            callback(bucket.keys[j],bucket.address[j]);
+          address_bucket=bucket.NextBucket;
         }
-        while(bucket.NextBucket>0);
-        if(i==end)
-          break;
       }
-      return result;
+    }
+
+    /**
+     * @brief Records and chain length of one bucket
+     *
+     * @param hash hash of the bucket
+     * @param n_records records of the bucket and its chain
+     * @param chain buckets of the chain, including the primary one
+     */
+    void bucketLoad(long hash, long &n_records, long &chain){
+      long address_bucket=primaryAddress(hash);
+      Bucket bucket;
+      n_records=0;
+      chain=0;
+      do{
+        bucket_pool->read(address_bucket,bucket);
+        n_records+=bucket.size;
+        chain++;
+        address_bucket=bucket.NextBucket;
+      }
+      while(bucket.NextBucket>0);
+    }
+
+    /**
+     * @brief Load of all the buckets, it is used to check that the hash
+     * spreads the keys and the overflow chains stay short
+     *
+     * @return BucketLoad
+     */
+    BucketLoad stats(){
+      BucketLoad load;
+      load.n_buckets=gd;
+      for(long i=0;i<(long)gd;i++){
+        long n_records, chain;
+        bucketLoad(i,n_records,chain);
+        load.n_records+=n_records;
+        load.n_overflow+=chain-1;
+        if(n_records==0)
+          load.empty_buckets++;
+        if(chain>load.max_chain)
+          load.max_chain=chain;
+        if(n_records>load.max_records){
+          load.max_records=n_records;
+          load.max_hash=i;
+        }
+        if((long)load.chains.size()<=chain)
+          load.chains.resize(chain+1,0);
+        load.chains[chain]++;
+      }
+      return load;
+    }
+
+    /**
+     * @brief Write back to disk the buckets modified in the buffer pool
+     *
+     */
+    void flush(){
+      if(bucket_pool)
+        bucket_pool->flushAll();
     }
 
     /**
@@ -189,10 +410,10 @@ namespace bd2{
       long address_bucket;
       for(long i=0;i<(long)gd;i++){
         std::cout<<"Bucket's Index "<<i<<std::endl;
-        address_bucket=i;
+        address_bucket=primaryAddress(i);
         Bucket bucket;
         do{
-          control_bucket->retrieve_record(address_bucket,bucket);
+          bucket_pool->read(address_bucket,bucket);
           for(int j=0;j<bucket.size;j++)
             std::cout<<bucket.keys[j]<<"/";
           address_bucket=bucket.NextBucket;
@@ -0,0 +1,264 @@
+/**
+ * @file write_ahead_log.h
+ * @author Juan Vargas Castillo (juan.vargas@utec.edu.pe)
+ * @author Giordano Alvitez Falcón (giordano.alvitez@utec.edu.pe)
+ * @author Roosevelt.Ubaldo Chavez (roosevelt.ubaldo@utec.edu.pe)
+ * @brief Write-Ahead Log Implementation, the writes of the attached files
+ * are kept in memory and committed in groups: the images of the written
+ * bytes are appended to the log with one fsync and then copied to the
+ * files. The committed groups are replayed on open (redo recovery)
+ * @version 0.1
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2020
+ *
+ */
+#pragma once
+#include "disk_manager.h"
+#include "positional_file.h"
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#define WAL_GROUP_SIZE 256 //operations committed by one fsync
+#define WAL_CHECKPOINT_BYTES (64L * 1024 * 1024) //size of the log that triggers a checkpoint
+
+namespace bd2{
+
+/**
+ * @brief Log of the writes of a set of files. A group is a sequence of
+ * entries (file, offset, bytes) closed by a commit record with the
+ * checksum of the group, so a group torn by a crash isn't replayed
+ */
+class WriteAheadLog{
+
+    using diskManager = std::shared_ptr<DiskManager>;
+
+    static const uint64_t ENTRY_MAGIC = 0x5952544e454c4157ULL; //"WALENTRY"
+    static const uint64_t COMMIT_MAGIC = 0x54494d4d4f434c57ULL; //"WLCOMMIT"
+
+    struct Entry{
+        uint64_t magic = ENTRY_MAGIC;
+        long file_id;
+        long offset;
+        long size;
+    };
+
+    struct Commit{
+        uint64_t magic = COMMIT_MAGIC;
+        long n_entries;
+        uint64_t checksum;
+    };
+
+    PositionalFile log;
+    std::vector<std::weak_ptr<DiskManager>> files; //attached files, the position is the file id
+    int group_size;
+    int operations = 0; //operations since the last commit
+    long n_commits = 0;
+    std::mutex latch;
+
+    /**
+     * @brief FNV-1a hash of a sequence of bytes
+     *
+     * @param bytes bytes of the group
+     * @param n number of bytes
+     * @return uint64_t
+     */
+    static uint64_t checksum(const char *bytes, long n){
+        uint64_t hash = 14695981039346656037ULL;
+        for (long i = 0; i < n; i++){
+            hash ^= (unsigned char) bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Write all the attached files to the device and empty the log,
+     * the files have every committed group so the log isn't needed
+     *
+     */
+    void checkpoint(){
+        for (auto &file : files)
+            if (diskManager manager = file.lock())
+                manager->sync();
+        log.truncate(0);
+    }
+
+public:
+
+    /**
+     * @brief Construct a new Write Ahead Log object
+     *
+     * @param path filename of the log
+     * @param _group_size operations committed by one fsync
+     * @param reset flag to truncate the log, the committed groups are lost
+     */
+    WriteAheadLog(const std::string &path, int _group_size = WAL_GROUP_SIZE, bool reset = false)
+        : group_size(_group_size > 0 ? _group_size : 1){
+        log.open(path, reset);
+    }
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog &) = delete;
+
+    /**
+     * @brief Attach a file to the log, its writes are kept in memory until
+     * they are committed. The files have to be attached in the same order
+     * every time the log is opened
+     *
+     * @param manager disk manager of the file
+     * @return long id of the file in the log
+     */
+    long attach(diskManager manager){
+        std::lock_guard<std::mutex> lock(latch);
+        std::lock_guard<std::mutex> file_lock(manager->pending_latch);
+        manager->logged = true;
+        files.push_back(manager);
+        return (long) files.size() - 1;
+    }
+
+    /**
+     * @brief Replay the committed groups of the log on the attached files,
+     * the log stops at the first torn or incomplete group
+     *
+     * @return long number of groups replayed
+     */
+    long recover(){
+        std::lock_guard<std::mutex> lock(latch);
+        long replayed = 0, offset = 0, end = log.size();
+        while (offset < end){
+            std::vector<std::pair<Entry, std::string>> group;
+            long group_start = offset;
+            Commit commit;
+            bool complete = false;
+            while (offset + (long) sizeof(Entry) <= end){
+                Entry entry;
+                log.read(offset, &entry, sizeof(entry));
+                if (entry.magic == COMMIT_MAGIC){
+                    log.read(offset, &commit, sizeof(commit));
+                    complete = offset + (long) sizeof(commit) <= end;
+                    break;
+                }
+                if (entry.magic != ENTRY_MAGIC || entry.size < 0 || offset + (long) sizeof(entry) + entry.size > end)
+                    break;
+                std::string bytes(entry.size, '\0');
+                log.read(offset + sizeof(entry), &bytes[0], entry.size);
+                offset += sizeof(entry) + entry.size;
+                group.emplace_back(entry, std::move(bytes));
+            }
+            if (!complete || commit.n_entries != (long) group.size())
+                break;
+            std::string image(offset - group_start, '\0');
+            log.read(group_start, &image[0], image.size());
+            if (commit.checksum != checksum(image.data(), image.size()))
+                break;
+            for (auto &write : group){
+                if (write.first.file_id < 0 || write.first.file_id >= (long) files.size())
+                    continue;
+                if (diskManager manager = files[write.first.file_id].lock()){
+                    manager->write_bytes(write.first.offset, write.second.data(), write.second.size());
+                    manager->empty = false;
+                }
+            }
+            offset += sizeof(commit);
+            replayed++;
+        }
+        checkpoint();
+        return replayed;
+    }
+
+    /**
+     * @brief Register the end of an operation, the operations are committed
+     * in groups
+     *
+     * @return true the group is complete and it has to be committed
+     * @return false the operation waits for the next commit
+     */
+    bool operationDone(){
+        std::lock_guard<std::mutex> lock(latch);
+        return ++operations >= group_size;
+    }
+
+    /**
+     * @brief Commit the pending writes of the attached files: they are
+     * appended to the log as one group, the log is written to the device
+     * (the durability point) and then the writes are copied to the files.
+     * It has to be called between operations, so a group never has half
+     * of an operation
+     *
+     */
+    void commit(){
+        std::lock_guard<std::mutex> lock(latch);
+        operations = 0;
+        std::vector<std::map<long, std::string>> writes(files.size());
+        std::string group;
+        long n_entries = 0;
+        for (long id = 0; id < (long) files.size(); id++){
+            diskManager manager = files[id].lock();
+            if (!manager)
+                continue;
+            std::lock_guard<std::mutex> file_lock(manager->pending_latch);
+            writes[id] = manager->pending;
+            for (auto &write : writes[id]){
+                Entry entry;
+                entry.file_id = id;
+                entry.offset = write.first;
+                entry.size = write.second.size();
+                group.append(reinterpret_cast<const char *>(&entry), sizeof(entry));
+                group.append(write.second);
+                n_entries++;
+            }
+        }
+        if (n_entries == 0)
+            return;
+        Commit commit;
+        commit.n_entries = n_entries;
+        commit.checksum = checksum(group.data(), group.size());
+        group.append(reinterpret_cast<const char *>(&commit), sizeof(commit));
+        log.append(group.data(), group.size());
+        log.sync();
+        n_commits++;
+
+        for (long id = 0; id < (long) files.size(); id++){
+            diskManager manager = files[id].lock();
+            if (!manager)
+                continue;
+            std::lock_guard<std::mutex> file_lock(manager->pending_latch);
+            for (auto &write : writes[id]){
+                manager->write_bytes(write.first, write.second.data(), write.second.size());
+                auto found = manager->pending.find(write.first);
+                if (found != manager->pending.end() && found->second == write.second)
+                    manager->pending.erase(found); //it wasn't overwritten during the commit
+            }
+            if (manager->pending.empty()){
+                manager->pending_end = 0;
+                manager->pending_max = 0;
+            }
+            manager->empty = false;
+            manager->flush();
+        }
+        if (log.size() >= WAL_CHECKPOINT_BYTES)
+            checkpoint();
+    }
+
+    /**
+     * @brief Number of groups committed since the log was opened
+     *
+     * @return long
+     */
+    long commits(){
+        std::lock_guard<std::mutex> lock(latch);
+        return n_commits;
+    }
+
+    /**
+     * @brief Bytes of the log
+     *
+     * @return long
+     */
+    long size(){ return log.size(); }
+};
+}
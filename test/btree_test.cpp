@@ -2,23 +2,33 @@
 #include <b_plus_tree.h>
 #include <disk_manager.h>
 #include <data_base_manager.h>
+#include <statichashing.h>
+#include <extendible_hashing.h>
 #include <vector>
+#include <array>
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
-#define PAGE_SIZE  64
-#define BTREE_ORDER   ((PAGE_SIZE - (2 * sizeof(long) + sizeof(int) +  2 * sizeof(long)) ) /  (sizeof(int) + sizeof(long)))
+#include <thread>
+#include <unistd.h>
+#define BTREE_ORDER 2 //small order, so the test trees have many levels
 using namespace std::chrono;
 
 struct DiskBasedBtree : public ::testing::Test
 {
 };
 
+//hash policy of the original static hashing, the key modulo the number of buckets
+struct IdentityHash {
+    template<typename T>
+    uint64_t operator()(const T &key) const { return (uint64_t) key; }
+};
+
 
 TEST_F(DiskBasedBtree, IndexingRandomElements) {
   bool trunc_file = true;
   std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("btree.index", trunc_file);
-  std::cout << "PAGE_SIZE: " << PAGE_SIZE << std::endl;
   std::cout << "BTREE_ORDER: " << BTREE_ORDER << std::endl;
   bd2::BPlusTree<char, BTREE_ORDER> bt(pm);
 
@@ -94,7 +104,7 @@ TEST_F(DiskBasedBtree, IteratorFromRandomPositionFrom) {
     long record_id;
     int key_pos;
     bt.find('j', record_id, key_pos);
-    char_btree_iterator iter (pm, record_id, key_pos);
+    char_btree_iterator iter = bt.from(record_id, key_pos);
     std:: string iter_values;
     for(; iter != bt.null(); iter++) {
         iter_values.push_back(*iter);
@@ -114,7 +124,7 @@ TEST_F(DiskBasedBtree, IteratorFromRandomPositionBack) {
     long record_id;
     int key_pos;
     bt.find('9', record_id, key_pos);
-    char_btree_iterator iter (pm, record_id, key_pos);
+    char_btree_iterator iter = bt.from(record_id, key_pos);
     std:: string iter_values;
     for(; iter != bt.null(); iter--) {
         iter_values.push_back(*iter);
@@ -126,6 +136,813 @@ TEST_F(DiskBasedBtree, IteratorFromRandomPositionBack) {
     EXPECT_EQ(all_values, iter_values);
 }
 
+TEST_F(DiskBasedBtree, IteratorReadsEachLeafOnce) {
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("scan.index", true);
+    bd2::BPlusTree<int, 16> bt(pm);
+    for (int i = 0; i < 2000; i++)
+        bt.insert(i, i * 10);
+    bt.flush();
+
+    std::shared_ptr<bd2::DiskManager> pm2 = std::make_shared<bd2::DiskManager>("scan.index");
+    bd2::BPlusTree<int, 16> reopened(pm2, 4); //smaller than the read-ahead window
+    long reads = reopened.getBufferPool()->physicalReads();
+    int key = 0;
+    for (auto iter = reopened.begin(4); iter != reopened.null(); ++iter, ++key){
+        EXPECT_EQ(*iter, key);
+        EXPECT_EQ(iter.getRecordId(), key * 10);
+    }
+    EXPECT_EQ(key, 2000);
+    long leaves = reopened.getBufferPool()->physicalReads() - reads;
+    EXPECT_LE(leaves, 2000 / 8 + 4); //each leaf is read once, plus the path to the first one
+
+    auto iter = reopened.end();
+    auto copy = iter--; //the copy keeps its own position
+    EXPECT_EQ(*copy, 1999);
+    for (key = 1998; iter != reopened.null(); iter--, key--)
+        EXPECT_EQ(*iter, key);
+    EXPECT_EQ(key, -1);
+}
+
+TEST_F(DiskBasedBtree, IteratorSeesUnflushedLeaves) {
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("unflushed.index", true);
+    bd2::BPlusTree<int, 16> bt(pm, 256); //the pool holds every node, nothing is written back
+    for (int i = 0; i < 500; i++)
+        bt.insert(i, i * 10);
+    long leaf;
+    int pos;
+    bt.find(100, leaf, pos);
+    int key = 100;
+    for (auto iter = bt.from(leaf, pos, 3); iter != bt.null(); ++iter, ++key){
+        EXPECT_EQ(*iter, key);
+        EXPECT_EQ(iter.getRecordId(), key * 10);
+    }
+    EXPECT_EQ(key, 500);
+}
+
+TEST_F(DiskBasedBtree, BufferPoolCachesUpperNodes) {
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("pool.index", true);
+    bd2::BPlusTree<int, 16> bt(pm, 64);
+    for (int i = 0; i < 2000; i++)
+        bt.insert(i, i * 10);
+    int disk_access = 0;
+    srand(7);
+    for (int i = 0; i < 2000; i++){
+        int key = rand() % 2000;
+        EXPECT_EQ(bt.getRecordIdByKeyValue(key, disk_access), key * 10);
+    }
+
+    //the inner nodes stay resident, so each lookup reads at most the leaf
+    long reads = bt.getBufferPool()->physicalReads();
+    for (int i = 0; i < 100; i++){
+        int key = rand() % 2000;
+        EXPECT_EQ(bt.getRecordIdByKeyValue(key, disk_access), key * 10);
+    }
+    EXPECT_LE(bt.getBufferPool()->physicalReads() - reads, 100);
+
+    reads = bt.getBufferPool()->physicalReads();
+    EXPECT_EQ(bt.getRecordIdByKeyValue(1000, disk_access), 10000);
+    EXPECT_EQ(bt.getBufferPool()->physicalReads(), reads);
+    bt.flush();
+
+    std::shared_ptr<bd2::DiskManager> pm2 = std::make_shared<bd2::DiskManager>("pool.index");
+    bd2::BPlusTree<int, 16> reopened(pm2);
+    for (int i = 0; i < 2000; i++)
+        EXPECT_EQ(reopened.getRecordIdByKeyValue(i, disk_access), i * 10);
+}
+
+TEST_F(DiskBasedBtree, PageHandlesPinInPlace) {
+    struct Page {
+        long value = 0;
+        char data[4088];
+    };
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("handle.dat", true);
+    auto pool = std::make_shared<bd2::BufferPool<Page>>(pm, 2);
+    {
+        std::vector<bd2::PageHandle<Page>> pinned;
+        for (long i = 0; i < 5; i++){ //more pages than frames, the pool grows instead of failing
+            pinned.emplace_back(pool, i, true);
+            pinned.back()->value = i * 100;
+            pinned.back().markDirty();
+        }
+        for (long i = 0; i < 5; i++)
+            EXPECT_EQ(pinned[i]->value, i * 100); //the pinned pages didn't move
+        bd2::PageHandle<Page> moved = std::move(pinned[0]);
+        moved->value = 7;
+    }
+    pool->flushAll();
+    Page page;
+    pool->read(0, page);
+    EXPECT_EQ(page.value, 7);
+    pool->read(4, page);
+    EXPECT_EQ(page.value, 400);
+
+    std::shared_ptr<bd2::DiskManager> pm2 = std::make_shared<bd2::DiskManager>("handle.index", true);
+    bd2::BPlusTree<int, 16> bt(pm2, 2); //the insertions pin the whole path
+    for (int i = 0; i < 3000; i++)
+        bt.insert((i * 7) % 3000, i);
+    for (int i = 0; i < 3000; i += 2)
+        EXPECT_TRUE(bt.erase(i));
+    int disk_access = 0;
+    for (int i = 0; i < 3000; i++)
+        EXPECT_EQ(bt.getRecordIdByKeyValue((i * 7) % 3000, disk_access), (i * 7) % 3000 % 2 ? i : -1);
+}
+
+TEST_F(DiskBasedBtree, DiskManagerResetTruncates) {
+    bd2::DiskManager::mode modes[] = {bd2::DiskManager::STREAM, bd2::DiskManager::MMAP, bd2::DiskManager::POSITIONAL};
+    for (auto mode : modes){
+        {
+            bd2::DiskManager dm("reset.dat", true, mode);
+            for (long i = 0; i < 10; i++)
+                dm.write_record(i, i);
+        }
+        {
+            bd2::DiskManager kept("reset.dat", false, mode);
+            EXPECT_EQ(kept.count_records<long>(), 10);
+        }
+        bd2::DiskManager reset("reset.dat", true, mode); //the existing file is emptied
+        EXPECT_TRUE(reset.is_empty());
+        EXPECT_EQ(reset.count_records<long>(), 0);
+    }
+}
+
+TEST_F(DiskBasedBtree, MappedDiskManager) {
+    {
+        bd2::DiskManager dm("mapped.dat", true, bd2::DiskManager::MMAP);
+        EXPECT_TRUE(dm.is_empty());
+        for (long i = 0; i < 100; i++)
+            dm.write_record(i, i);
+        long value = 100;
+        EXPECT_EQ(dm.write_record_to_ending(value), 100);
+        const long *borrowed = dm.borrow_record<long>(42);
+        ASSERT_NE(borrowed, nullptr);
+        EXPECT_EQ(*borrowed, 42);
+        EXPECT_EQ(dm.borrow_record<long>(101), nullptr);
+    }
+    std::shared_ptr<bd2::DiskManager> dm = std::make_shared<bd2::DiskManager>("mapped.dat", false, bd2::DiskManager::MMAP);
+    EXPECT_FALSE(dm->is_empty());
+    EXPECT_EQ(dm->count_records<long>(), 101);
+    long value = -1;
+    EXPECT_TRUE(dm->retrieve_record(100, value));
+    EXPECT_EQ(value, 100);
+
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("mapped.index", true, bd2::DiskManager::MMAP);
+    bd2::BPlusTree<int, BTREE_ORDER> bt(pm);
+    for (int i = 0; i < 300; i++)
+        bt.insert(i, i);
+    bt.flush();
+    int disk_access = 0;
+    for (int i = 0; i < 300; i++)
+        EXPECT_EQ(bt.getRecordIdByKeyValue(i, disk_access), i);
+}
+
+TEST_F(DiskBasedBtree, MappedFileWithoutClose) {
+    auto copy = [](const std::string &from, const std::string &to){ //the bytes a killed process leaves on disk
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to, std::ios::binary | std::ios::trunc);
+        out << in.rdbuf();
+    };
+    {
+        bd2::DiskManager dm("mapped_open.dat", true, bd2::DiskManager::MMAP);
+        for (long i = 0; i < 10; i++)
+            dm.write_record(i, i);
+        copy("mapped_open.dat", "mapped_killed.dat");
+    }
+    std::ifstream killed("mapped_killed.dat", std::ios::binary | std::ios::ate);
+    EXPECT_EQ((long) killed.tellg(), MAPPED_FILE_CHUNK); //the file wasn't truncated
+    killed.close();
+    {
+        bd2::DiskManager dm("mapped_killed.dat", false, bd2::DiskManager::MMAP);
+        EXPECT_EQ(dm.count_records<long>(), 10);
+        long value = 10;
+        EXPECT_EQ(dm.write_record_to_ending(value), 10);
+    }
+    bd2::DiskManager dm("mapped_killed.dat", false, bd2::DiskManager::MMAP);
+    EXPECT_EQ(dm.count_records<long>(), 11);
+
+    {
+        std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("mapped_open.index", true, bd2::DiskManager::MMAP);
+        bd2::BPlusTree<int, BTREE_ORDER> bt(pm);
+        for (int i = 0; i < 300; i++)
+            bt.insert(i, i);
+        bt.flush();
+        copy("mapped_open.index", "mapped_killed.index");
+    }
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("mapped_killed.index", false, bd2::DiskManager::MMAP);
+    using page = bd2::Node<int, BTREE_ORDER>;
+    long pages = pm->count_records<page>();
+    bd2::BPlusTree<int, BTREE_ORDER> bt(pm);
+    int disk_access = 0;
+    for (int i = 0; i < 300; i++)
+        EXPECT_EQ(bt.getRecordIdByKeyValue(i, disk_access), i);
+    bt.insert(300, 300);
+    bt.flush();
+    EXPECT_LE(pm->count_records<page>(), pages + 2); //the new nodes follow the old ones
+}
+
+TEST_F(DiskBasedBtree, PositionalAppendFailure) {
+    bd2::DiskManager dm("/dev/full", false, bd2::DiskManager::POSITIONAL); //every write fails with ENOSPC
+    long value = 5;
+    EXPECT_EQ(dm.write_record_to_ending(value), -1);
+    EXPECT_EQ(dm.count_records<long>(), 0); //the failed append didn't keep its space
+}
+
+TEST_F(DiskBasedBtree, PositionalDiskManagerThreads) {
+    std::shared_ptr<bd2::DiskManager> dm = std::make_shared<bd2::DiskManager>("positional.dat", true, bd2::DiskManager::POSITIONAL);
+    const int n_threads = 4;
+    const long per_thread = 1000;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < n_threads; t++)
+        writers.emplace_back([&dm, t, per_thread](){
+            for (long i = t * per_thread; i < (t + 1) * per_thread; i++){
+                long value = i;
+                dm->write_record(i, value);
+            }
+        });
+    for (auto &w : writers)
+        w.join();
+    EXPECT_EQ(dm->count_records<long>(), n_threads * per_thread);
+
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("positional.index", true, bd2::DiskManager::POSITIONAL);
+    bd2::BPlusTree<int, BTREE_ORDER> bt(pm);
+    for (int i = 0; i < 500; i++)
+        bt.insert(i, i);
+
+    std::vector<int> errors(n_threads, 0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < n_threads; t++)
+        readers.emplace_back([&, t](){
+            for (long i = 0; i < n_threads * per_thread; i++){
+                long value = -1;
+                if (!dm->retrieve_record(i, value) || value != i)
+                    errors[t]++;
+            }
+            for (int i = 0; i < 500; i++){
+                int disk_access = 0;
+                if (bt.getRecordIdByKeyValue(i, disk_access) != i)
+                    errors[t]++;
+            }
+        });
+    for (auto &r : readers)
+        r.join();
+    for (int e : errors)
+        EXPECT_EQ(e, 0);
+}
+
+TEST_F(DiskBasedBtree, RetrieveRecordsInRuns) {
+    bd2::DiskManager::mode modes[] = {bd2::DiskManager::STREAM, bd2::DiskManager::MMAP, bd2::DiskManager::POSITIONAL};
+    for (auto mode : modes){
+        bd2::DiskManager dm("multiget.dat", true, mode);
+        for (long i = 0; i < 1000; i++){
+            long value = i * 3;
+            dm.write_record(i, value);
+        }
+        std::vector<long> positions;
+        for (long i = 0; i < 2000; i++)
+            positions.push_back((i * 7919) % 1000); //scattered positions
+        positions.push_back(5); //repeated position
+        positions.push_back(-1);
+        positions.push_back(5000); //out of the file
+        std::vector<long> values;
+        EXPECT_EQ(dm.retrieve_records(positions, values, 4), 2001);
+        ASSERT_EQ(values.size(), positions.size());
+        for (size_t i = 0; i < 2001; i++)
+            EXPECT_EQ(values[i], positions[i] * 3);
+    }
+}
+
+TEST_F(DiskBasedBtree, BlockReaderChunks) {
+    {
+        std::ofstream out("blocks.bin", std::ios::out | std::ios::binary | std::ios::trunc);
+        for (long i = 0; i < 1000; i++)
+            out.write((char *) &i, sizeof(i));
+        out.write("abc", 3); //incomplete record at the end
+    }
+    long expected = 0;
+    bd2::BlockReader<long> all("blocks.bin", 0, -1, 7 * sizeof(long));
+    const long *records;
+    long count;
+    while (all.next(records, count)){
+        EXPECT_LE(count, 7);
+        for (long i = 0; i < count; i++)
+            EXPECT_EQ(records[i], expected++);
+    }
+    EXPECT_EQ(expected, 1000);
+
+    expected = 250;
+    bd2::BlockReader<long> slice("blocks.bin", 250, 500, 64 * sizeof(long));
+    while (slice.next(records, count))
+        for (long i = 0; i < count; i++)
+            EXPECT_EQ(records[i], expected++);
+    EXPECT_EQ(expected, 500);
+
+    bd2::BlockReader<long> missing("missing.bin");
+    EXPECT_FALSE(missing.next(records, count));
+}
+
+TEST_F(DiskBasedBtree, BulkLoad) {
+    std::vector<std::pair<int, long>> entries;
+    for (int i = 0; i < 1000; i++)
+        entries.push_back(std::make_pair(i * 2, (long) i));
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("bulk.index", true);
+    bd2::BPlusTree<int, 8> bt(pm);
+    EXPECT_TRUE(bt.bulkLoad(entries.begin(), entries.end(), 0.75));
+    EXPECT_FALSE(bt.bulkLoad(entries.begin(), entries.end()));
+
+    int disk_access = 0;
+    for (int i = 0; i < 1000; i++)
+        EXPECT_EQ(bt.getRecordIdByKeyValue(i * 2, disk_access), i);
+    EXPECT_FALSE(bt.isKeyPresent(7));
+
+    std::string forward;
+    for (auto iter = bt.begin(); iter != bt.null(); iter++)
+        forward += std::to_string(*iter) + ",";
+    std::string expected;
+    for (int i = 0; i < 1000; i++)
+        expected += std::to_string(i * 2) + ",";
+    EXPECT_EQ(forward, expected);
+
+    //the bulk loaded tree accepts normal inserts
+    for (int i = 0; i < 1000; i++)
+        bt.insert(i * 2 + 1, 1000 + i);
+    for (int i = 0; i < 2000; i++)
+        EXPECT_EQ(bt.getRecordIdByKeyValue(i, disk_access), i % 2 == 0 ? i / 2 : 1000 + i / 2);
+}
+
+TEST_F(DiskBasedBtree, BulkLoadHalfFullNodes) {
+    for (int n = 1; n <= 120; n++){ //n just above a multiple of the leaf size leaves a short last group
+        std::vector<std::pair<int, long>> entries;
+        for (int i = 0; i < n; i++)
+            entries.push_back(std::make_pair(i * 3, (long) i));
+        {
+            std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("bulk_half.index", true);
+            bd2::BPlusTree<int, 8> bt(pm);
+            ASSERT_TRUE(bt.bulkLoad(entries.begin(), entries.end(), 0.5));
+        }
+        long max_nodes = std::max(1, n / 4), level = max_nodes; //every node but the root has 4 keys or 5 children
+        while (level > 1){
+            level = std::max(1L, level / 5);
+            max_nodes += level;
+        }
+        std::ifstream file("bulk_half.index", std::ios::binary | std::ios::ate);
+        EXPECT_LE((long) file.tellg() / (long) sizeof(bd2::Node<int, 8>) - 1, max_nodes) << "n " << n; //the page 0 is the header
+        file.close();
+
+        std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("bulk_half.index");
+        bd2::BPlusTree<int, 8> bt(pm);
+        std::vector<int> order(n);
+        for (int i = 0; i < n; i++)
+            order[i] = i;
+        std::random_shuffle(order.begin(), order.end());
+        int disk_access = 0;
+        for (int k = 0; k < n; k++){
+            ASSERT_TRUE(bt.erase(order[k] * 3)) << "n " << n;
+            for (int j = k + 1; j < n; j++)
+                ASSERT_EQ(bt.getRecordIdByKeyValue(order[j] * 3, disk_access), order[j]) << "n " << n;
+        }
+        EXPECT_TRUE(bt.isEmpty());
+    }
+
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("bulk_half.index", true);
+    bd2::BPlusTree<int, 8> bt(pm);
+    std::vector<std::pair<int, long>> unsorted = {{1, 0}, {5, 1}, {3, 2}};
+    std::vector<std::pair<int, long>> repeated = {{1, 0}, {3, 1}, {3, 2}};
+    EXPECT_FALSE(bt.bulkLoad(unsorted.begin(), unsorted.end()));
+    EXPECT_FALSE(bt.bulkLoad(repeated.begin(), repeated.end()));
+    EXPECT_TRUE(bt.isEmpty()); //nothing was written
+}
+
+TEST_F(DiskBasedBtree, NodeSearchMatchesLowerBound) {
+    srand(11);
+    for (int it = 0; it < 2000; it++){
+        int n = rand() % 1001;
+        std::vector<int> ints(n);
+        std::vector<long> longs(n);
+        std::vector<char> chars(n);
+        for (int i = 0; i < n; i++){
+            ints[i] = rand() % 200 - 100;
+            longs[i] = ints[i];
+            chars[i] = (char) (ints[i] / 2);
+        }
+        std::sort(ints.begin(), ints.end());
+        std::sort(longs.begin(), longs.end());
+        std::sort(chars.begin(), chars.end());
+        int val = rand() % 220 - 110;
+        EXPECT_EQ((bd2::NodeSearch<int, 1000>::lowerBound(ints.data(), n, val)),
+                  std::lower_bound(ints.begin(), ints.end(), val) - ints.begin());
+        EXPECT_EQ((bd2::NodeSearch<long, 1000>::lowerBound(longs.data(), n, (long) val)),
+                  std::lower_bound(longs.begin(), longs.end(), (long) val) - longs.begin());
+        EXPECT_EQ((bd2::NodeSearch<char, 1000>::lowerBound(chars.data(), n, (char) (val / 2))),
+                  std::lower_bound(chars.begin(), chars.end(), (char) (val / 2)) - chars.begin());
+    }
+}
+
+TEST_F(DiskBasedBtree, PageSizedNodes) {
+    EXPECT_EQ(sizeof(bd2::Node<int, bd2::PageOrder<int, 4096>::value>), 4096u);
+    EXPECT_EQ(sizeof(bd2::Node<long, bd2::PageOrder<long, 8192>::value>), 8192u);
+    EXPECT_EQ(sizeof(bd2::Node<char, bd2::PageOrder<char, 16384>::value>), 16384u);
+    EXPECT_EQ(sizeof(bd2::Node<char, BTREE_ORDER>) % NODE_PAGE_SIZE, 0u);
+    EXPECT_GT((bd2::PageOrder<int, 4096>::value), (bd2::PageOrder<long, 4096>::value));
+    long both_arrays = (4096 - 40 - 4 * sizeof(long)) / (3 * sizeof(long)); //167, a page with children and records
+    EXPECT_GE((bd2::PageOrder<long, 4096>::value), both_arrays * 3 / 2); //one child or record per key, not both
+    EXPECT_LT((bd2::PageOrder<long, 4096>::value), both_arrays * 2); //the key is still stored, so the gain is 1.5x
+    EXPECT_GT(sizeof(bd2::NodeLayout<long, bd2::PageOrder<long, 4096>::value + 1>), 4096u); //the order is the largest one
+    EXPECT_GT(sizeof(bd2::NodeLayout<bd2::FixedString<30>, bd2::PageOrder<bd2::FixedString<30>, 4096>::value + 1>), 4096u);
+
+    bd2::Node<int, 16> fresh(3, true);
+    const char *bytes = reinterpret_cast<const char *>(&fresh);
+    EXPECT_EQ(std::count(bytes + sizeof(bd2::NodeLayout<int, 16>), bytes + sizeof(fresh), 0),
+              (long) (sizeof(fresh) - sizeof(bd2::NodeLayout<int, 16>))); //the padding is zeroed
+
+    using page_btree = bd2::BPlusTree<long, bd2::PageOrder<long, 4096>::value>;
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("page.index", true);
+    page_btree bt(pm);
+    for (long i = 0; i < 5000; i++)
+        bt.insert(i, i);
+    bt.flush();
+    std::ifstream file("page.index", std::ios::binary | std::ios::ate);
+    EXPECT_EQ((long) file.tellg() % 4096, 0);
+}
+
+TEST_F(DiskBasedBtree, FixedStringKeys) {
+    using city = bd2::FixedString<30>;
+    EXPECT_LT(city("Lima"), city("Lima Norte")); //shorter strings first
+    EXPECT_LT(city("Lambayeque"), city("Lambayequf")); //same 8 bytes prefix
+    EXPECT_LT(city("Zarumilla"), city("\xc3\x91uble")); //unsigned bytes
+    char field[30] = "Cusco";
+    EXPECT_EQ(city(field), city(std::string("Cusco")));
+    EXPECT_EQ(city(field).str(), "Cusco");
+
+    srand(17);
+    for (int it = 0; it < 500; it++){
+        int n = rand() % 300;
+        std::vector<city> keys;
+        for (int i = 0; i < n; i++)
+            keys.push_back(city("prefix" + std::to_string(rand() % 1000)));
+        std::sort(keys.begin(), keys.end());
+        city val("prefix" + std::to_string(rand() % 1000));
+        EXPECT_EQ((bd2::NodeSearch<city, 300>::lowerBound(keys.data(), n, val)),
+                  std::lower_bound(keys.begin(), keys.end(), val) - keys.begin());
+    }
+
+    using city_btree = bd2::BPlusTree<city, bd2::PageOrder<city, 4096>::value>;
+    {
+        std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("city.index", true);
+        city_btree bt(pm);
+        for (long i = 0; i < 3000; i++)
+            bt.insert(city("district-" + std::to_string(i * 7 % 3000)), i * 7 % 3000);
+        bt.flush();
+    }
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("city.index");
+    city_btree bt(pm);
+    int disk_access = 0;
+    EXPECT_EQ(bt.getRecordIdByKeyValue(city("district-1234"), disk_access), 1234);
+    EXPECT_EQ(bt.getRecordIdByKeyValue(city("district-"), disk_access), -1);
+    std::vector<long> range = bt.range_search(city("district-10"), city("district-11"));
+    EXPECT_EQ(range.size(), 112u); //10, 100..109, 1000..1099 and 11
+    city previous;
+    for (auto it = bt.begin(); it != bt.end(); ++it){
+        EXPECT_LT(previous, *it);
+        previous = *it;
+    }
+    for (long i = 0; i < 3000; i += 2)
+        EXPECT_TRUE(bt.erase(city("district-" + std::to_string(i))));
+    EXPECT_FALSE(bt.isKeyPresent(city("district-1234")));
+    EXPECT_TRUE(bt.isKeyPresent(city("district-1235")));
+}
+
+TEST_F(DiskBasedBtree, EraseWithMergeAndRedistribute) {
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("erase.index", true);
+    bd2::BPlusTree<int, BTREE_ORDER> bt(pm);
+    std::vector<int> keys;
+    for (int i = 0; i < 300; i++)
+        keys.push_back(i);
+    srand(3);
+    for (int i = (int) keys.size() - 1; i > 0; i--)
+        std::swap(keys[i], keys[rand() % (i + 1)]);
+    for (int k : keys)
+        bt.insert(k, k);
+
+    EXPECT_FALSE(bt.erase(1000));
+    for (int i = 0; i < 150; i++)
+        EXPECT_TRUE(bt.erase(keys[i]));
+    for (int i = 0; i < 300; i++)
+        EXPECT_EQ(bt.isKeyPresent(keys[i]), i >= 150);
+
+    //the leaf chain stays ordered in both directions
+    std::vector<int> remaining(keys.begin() + 150, keys.end());
+    std::sort(remaining.begin(), remaining.end());
+    std::vector<int> forward, backward;
+    for (auto iter = bt.begin(); iter != bt.null(); iter++)
+        forward.push_back(*iter);
+    for (auto iter = bt.end(); iter != bt.null(); iter--)
+        backward.push_back(*iter);
+    std::reverse(backward.begin(), backward.end());
+    EXPECT_EQ(forward, remaining);
+    EXPECT_EQ(backward, remaining);
+
+    for (int i = 150; i < 300; i++)
+        EXPECT_TRUE(bt.erase(keys[i]));
+    EXPECT_TRUE(bt.isEmpty());
+}
+
+TEST_F(DiskBasedBtree, EraseReusesFreedNodes) {
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("churn.index", true);
+    bd2::BPlusTree<int, 4> bt(pm);
+    using int_node = bd2::Node<int, 4>;
+    long size = 0;
+    for (int round = 0; round < 5; round++){
+        for (int i = 0; i < 200; i++)
+            bt.insert(round * 1000 + i, i);
+        for (int i = 0; i < 200; i++)
+            EXPECT_TRUE(bt.erase(round * 1000 + i));
+        bt.flush();
+        if (round == 0)
+            size = pm->count_records<int_node>();
+        EXPECT_EQ(pm->count_records<int_node>(), size);
+    }
+    EXPECT_TRUE(bt.isEmpty());
+}
+
+TEST_F(DiskBasedBtree, FreeListLinkBeforeHeader) {
+    using page = bd2::Node<int, BTREE_ORDER>;
+    std::shared_ptr<bd2::DiskManager> dm = std::make_shared<bd2::DiskManager>("free_list.index", true, bd2::DiskManager::POSITIONAL);
+    auto pool = std::make_shared<bd2::BufferPool<page>>(dm, 8);
+    bd2::PageAllocator<page> allocator(dm, pool);
+    std::vector<long> pages;
+    for (int i = 0; i < 4; i++)
+        pages.push_back(allocator.allocate());
+    allocator.release(pages[1]);
+    allocator.release(pages[3]);
+
+    bd2::DiskManager file("free_list.index", false, bd2::DiskManager::POSITIONAL); //what a crash leaves on the file
+    long header[2] = {};
+    ASSERT_TRUE(file.retrieve_record(0, header));
+    EXPECT_EQ(header[1], pages[3]);
+    page released;
+    ASSERT_TRUE(file.retrieve_record(pages[3], released));
+    EXPECT_EQ(released.nextFreePage(), pages[1]);
+    ASSERT_TRUE(file.retrieve_record(pages[1], released));
+    EXPECT_EQ(released.nextFreePage(), 0);
+}
+
+TEST_F(DiskBasedBtree, StaticHashingReusesOverflowBuckets) {
+    using hashing = bd2::StaticHashing<int, 7, 2, IdentityHash>; //every round fills the same buckets
+    using bucket = bd2::Bucket_S<int, 2>;
+    std::shared_ptr<bd2::DiskManager> buckets = std::make_shared<bd2::DiskManager>("churn.bucket", true);
+    std::shared_ptr<bd2::DiskManager> data = std::make_shared<bd2::DiskManager>("churn.dat", true);
+    hashing sh(buckets, data);
+    long size = 0;
+    for (int round = 0; round < 4; round++){
+        for (int i = 0; i < 100; i++)
+            sh.insert(i, round * 100 + i);
+        for (int i = 0; i < 100; i++)
+            EXPECT_EQ(sh.search(round * 100 + i), i);
+        for (int i = 0; i < 100; i += 2)
+            EXPECT_TRUE(sh.erase(round * 100 + i));
+        for (int i = 1; i < 100; i += 2)
+            EXPECT_EQ(sh.search(round * 100 + i), i);
+        for (int i = 1; i < 100; i += 2)
+            EXPECT_TRUE(sh.erase(round * 100 + i));
+        EXPECT_FALSE(sh.erase(round * 100));
+        sh.flush();
+        if (round == 0)
+            size = buckets->count_records<bucket>();
+        EXPECT_EQ(buckets->count_records<bucket>(), size);
+    }
+}
+
+TEST_F(DiskBasedBtree, StaticHashingSpreadsStridedKeys) {
+    std::shared_ptr<bd2::DiskManager> data = std::make_shared<bd2::DiskManager>("spread.dat", true);
+    std::shared_ptr<bd2::DiskManager> mixed_buckets = std::make_shared<bd2::DiskManager>("spread.bucket", true);
+    std::shared_ptr<bd2::DiskManager> modulo_buckets = std::make_shared<bd2::DiskManager>("modulo.bucket", true);
+    bd2::StaticHashing<long, 64, 4> mixed(mixed_buckets, data);
+    bd2::StaticHashing<long, 64, 4, IdentityHash> modulo(modulo_buckets, data);
+    for (long i = 0; i < 1024; i++){ //strided ids, all of them are multiple of the number of buckets
+        mixed.insert(i, i * 64);
+        modulo.insert(i, i * 64);
+    }
+    bd2::BucketLoad clustered = modulo.stats();
+    EXPECT_EQ(clustered.n_records, 1024);
+    EXPECT_EQ(clustered.empty_buckets, 63);
+    EXPECT_EQ(clustered.max_chain, 256);
+    EXPECT_EQ(clustered.max_hash, 0);
+
+    bd2::BucketLoad spread = mixed.stats();
+    EXPECT_EQ(spread.n_records, 1024);
+    EXPECT_LE(spread.empty_buckets, 2);
+    EXPECT_LE(spread.max_chain, 10);
+    for (long i = 0; i < 1024; i++)
+        EXPECT_EQ(mixed.search(i * 64), i);
+
+    using name = std::array<char, 12>; //fixed char keys are hashed by their bytes
+    std::shared_ptr<bd2::DiskManager> name_buckets = std::make_shared<bd2::DiskManager>("names.bucket", true);
+    bd2::StaticHashing<name, 16, 4> names(name_buckets, data);
+    for (long i = 0; i < 100; i++){
+        name key{};
+        snprintf(key.data(), key.size(), "name%ld", i);
+        names.insert(i, key);
+    }
+    EXPECT_LE(names.stats().max_chain, 5);
+    name key{};
+    snprintf(key.data(), key.size(), "name%d", 42);
+    EXPECT_EQ(names.search(key), 42);
+}
+
+TEST_F(DiskBasedBtree, StaticHashingRangeSearch) {
+    using hashing = bd2::StaticHashing<long, 64, 4>;
+    std::shared_ptr<bd2::DiskManager> buckets = std::make_shared<bd2::DiskManager>("range.bucket", true);
+    std::shared_ptr<bd2::DiskManager> data = std::make_shared<bd2::DiskManager>("range.dat", true);
+    hashing sh(buckets, data);
+    for (long i = 0; i < 1000; i++)
+        sh.insert(i, i * 2); //only even keys
+    std::vector<long> narrow = sh.search_by_range(100, 119); //the chains of the keys are probed
+    std::sort(narrow.begin(), narrow.end());
+    ASSERT_EQ(narrow.size(), 10);
+    for (long i = 0; i < 10; i++)
+        EXPECT_EQ(narrow[i], 50 + i);
+    EXPECT_EQ(sh.search_by_range(1000, 2999).size(), 500); //full scan of the chains
+    EXPECT_EQ(sh.search_by_range(-1000000, 1000000).size(), 1000);
+    EXPECT_EQ(sh.search_by_range(5000, 6000).size(), 0);
+    EXPECT_EQ(sh.search_by_range(10, 0).size(), 0);
+    for (long i = 0; i < 1000; i += 2)
+        EXPECT_TRUE(sh.erase(i * 2));
+    EXPECT_EQ(sh.search_by_range(0, 1998).size(), 500);
+    EXPECT_EQ(sh.search_by_range(100, 119).size(), 5);
+}
+
+TEST_F(DiskBasedBtree, ExtendibleHashingSplitsBuckets) {
+    using hashing = bd2::ExtendibleHashing<long, 4>;
+    std::shared_ptr<bd2::DiskManager> buckets = std::make_shared<bd2::DiskManager>("extendible.bucket", true);
+    std::shared_ptr<bd2::DiskManager> data = std::make_shared<bd2::DiskManager>("extendible.dat", true);
+    const long n = 5000;
+    {
+        hashing eh(buckets, data);
+        for (long i = 0; i < n; i++)
+            eh.insert(i * 10, i);
+        for (long i = 0; i < 20; i++)
+            eh.insert(i, 7); //the same key many times, its bucket is chained
+        EXPECT_GT(eh.depth(), 0);
+        for (long i = 0; i < n; i++)
+            EXPECT_EQ(eh.search(i), i * 10);
+        EXPECT_EQ(eh.search(n), -1);
+        EXPECT_EQ(eh.search_by_range(100, 199).size(), 100);
+        EXPECT_TRUE(eh.erase(3));
+        EXPECT_FALSE(eh.erase(3));
+        eh.flush();
+    }
+    hashing reopened(buckets, data); //the directory is rebuilt from the buckets
+    for (long i = 0; i < n; i++){
+        if (i != 3){
+            EXPECT_EQ(reopened.search(i), i * 10);
+        }
+    }
+    EXPECT_EQ(reopened.search(3), -1);
+    long sevens = 0;
+    while (reopened.erase(7))
+        sevens++;
+    EXPECT_EQ(sevens, 21);
+}
+
+TEST_F(DiskBasedBtree, ExtendibleHashingSplitsChains) {
+    using hashing = bd2::ExtendibleHashing<long, 4>;
+    std::shared_ptr<bd2::DiskManager> buckets = std::make_shared<bd2::DiskManager>("extendible_chain.bucket", true);
+    std::shared_ptr<bd2::DiskManager> data = std::make_shared<bd2::DiskManager>("extendible_chain.dat", true);
+    {
+        hashing eh(buckets, data);
+        for (long i = 0; i < 6; i++)
+            eh.insert(i, 7); //the bucket of 7 is chained before it is split
+        for (long key = 1000; key < 1100; key++)
+            eh.insert(key, key);
+        for (long key = 1000; key < 1100; key++)
+            EXPECT_EQ(eh.search(key), key);
+        EXPECT_EQ(eh.search_by_range(7, 7).size(), 6u);
+        eh.flush();
+    }
+    hashing reopened(buckets, data);
+    long sevens = 0;
+    while (reopened.erase(7))
+        sevens++;
+    EXPECT_EQ(sevens, 6);
+    for (long key = 1000; key < 1100; key++)
+        EXPECT_EQ(reopened.search(key), key);
+}
+
+TEST_F(DiskBasedBtree, ConcurrentReadersAndWriters){
+    std::shared_ptr<bd2::DiskManager> pm = std::make_shared<bd2::DiskManager>("concurrent.index", true);
+    bd2::BPlusTree<long, 8> bt(pm);
+    const long n_preloaded = 2000, n_threads = 4, per_thread = 2000;
+    for (long i = 0; i < n_preloaded; i++)
+        bt.insert(2 * i, i); //even keys, they are searched while the odd keys are inserted
+
+    std::vector<std::thread> threads;
+    std::vector<long> wrong(n_threads, 0);
+    for (long t = 0; t < n_threads; t++){
+        threads.emplace_back([&bt, t, per_thread, n_threads](){
+            for (long i = 0; i < per_thread; i++){
+                long key = 2 * (i * n_threads + t) + 1;
+                bt.insert(key, key);
+            }
+        });
+        threads.emplace_back([&bt, &wrong, t, n_preloaded](){
+            for (long i = t; i < n_preloaded; i += 2){
+                int disk_access = 0;
+                if (bt.getRecordIdByKeyValue(2 * i, disk_access) != i)
+                    wrong[t]++;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    for (long t = 0; t < n_threads; t++)
+        EXPECT_EQ(wrong[t], 0);
+    for (long key = 1; key < 2 * n_threads * per_thread; key += 2){
+        int disk_access = 0;
+        EXPECT_EQ(bt.getRecordIdByKeyValue(key, disk_access), key);
+    }
+    long previous = -1, count = 0;
+    for (auto it = bt.begin(); it != bt.null(); ++it, count++){
+        EXPECT_LT(previous, *it);
+        previous = *it;
+    }
+    EXPECT_EQ(count, n_preloaded + n_threads * per_thread);
+    EXPECT_EQ(bt.range_search(100, 110).size(), 11);
+}
+
+TEST_F(DiskBasedBtree, WriteAheadLogRecovery){
+    struct Row {
+        long id;
+        char payload[56];
+    };
+    using database = bd2::DataBase<Row, long>;
+    auto copyFile = [](const std::string &from, const std::string &to){
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to, std::ios::binary | std::ios::trunc);
+        out << in.rdbuf();
+    };
+    {
+        database db(std::make_shared<bd2::DiskManager>("wal.index", true),
+                    std::make_shared<bd2::DiskManager>("wal.dat", true), 0);
+        EXPECT_EQ(db.enableWriteAheadLog("wal.log", 16, true), 0);
+        copyFile("wal.index", "base.index"); //state of the files before the crash
+        copyFile("wal.dat", "base.dat");
+        for (long i = 0; i < 100; i++){
+            Row row{i * 7 % 100, "row"};
+            db.insertWithBPlusTreeIndex(row, row.id, false);
+        }
+        copyFile("wal.log", "crash.log"); //6 groups of 16 inserts are committed
+    }
+    //the crash loses every write that reached the files after the log
+    copyFile("base.index", "wal.index");
+    copyFile("base.dat", "wal.dat");
+    copyFile("crash.log", "wal.log");
+    std::ofstream torn("wal.log", std::ios::binary | std::ios::app);
+    torn << "torn group";
+    torn.close();
+
+    database db(std::make_shared<bd2::DiskManager>("wal.index"),
+                std::make_shared<bd2::DiskManager>("wal.dat"), 0);
+    EXPECT_EQ(db.enableWriteAheadLog("wal.log", 16), 6);
+    for (long i = 0; i < 100; i++){
+        Row row{};
+        long key = i * 7 % 100;
+        EXPECT_EQ(db.readRecord(row, key), i < 96);
+        if (i < 96){
+            EXPECT_EQ(row.id, key);
+        }
+    }
+}
+
+TEST_F(DiskBasedBtree, WriteAheadLogOverlappingWrites){
+    struct Header {
+        long first;
+        long second;
+    };
+    std::shared_ptr<bd2::DiskManager> dm = std::make_shared<bd2::DiskManager>("staged.dat", true);
+    bd2::WriteAheadLog wal("staged.log", 16, true);
+    wal.attach(dm);
+    long nine = 9;
+    dm->write_record(1, nine);
+    long block[4] = {1, 2, 3, 4};
+    dm->write_records(0, block, 4); //it starts before the older write and covers it
+    long tail[2] = {50, 60};
+    dm->write_records(3, tail, 2); //it starts inside the block and ends after it
+    Header header{100, 200};
+    dm->write_record(0, header); //it covers the first two longs of the block
+    long expected[5] = {100, 200, 3, 50, 60};
+
+    long staged[5] = {};
+    EXPECT_EQ(dm->retrieve_block(0, staged, 5), 5);
+    EXPECT_TRUE(std::equal(staged, staged + 5, expected));
+    EXPECT_EQ(dm->count_records<long>(), 5);
+
+    wal.commit();
+    bd2::DiskManager file("staged.dat");
+    long written[5] = {};
+    EXPECT_EQ(file.retrieve_block(0, written, 5), 5);
+    EXPECT_TRUE(std::equal(written, written + 5, expected));
+}
+
 TEST_F(DiskBasedBtree, DatabaseInsert){
     struct Student {
         long  id;
@@ -171,6 +988,265 @@ TEST_F(DiskBasedBtree, DatabaseInsert){
         }
     }
 }
+
+TEST_F(DiskBasedBtree, RangeScanStreamsRecords){
+    struct Row {
+        long id;
+        char payload[56];
+    };
+    bd2::DataBase<Row, long> db(std::make_shared<bd2::DiskManager>("range_scan.index", true),
+                                std::make_shared<bd2::DiskManager>("range_scan.dat", true), 0);
+    for (long i = 0; i < 1000; i++){
+        Row row{i, ""};
+        db.insertWithBPlusTreeIndex(row, row.id, true);
+    }
+    long expected = 100;
+    long n = db.scanRecordRange(100, 899, [&expected](Row &row){
+        EXPECT_EQ(row.id, expected++);
+        return true;
+    });
+    EXPECT_EQ(n, 800);
+    EXPECT_EQ(expected, 900);
+
+    n = db.scanRecordRange(100, 899, [](Row &row){ return row.id < 109; }); //early termination
+    EXPECT_EQ(n, 10);
+    std::vector<Row> rows;
+    EXPECT_TRUE(db.readRecordRange(rows, 500, 999, 25));
+    ASSERT_EQ(rows.size(), 25);
+    EXPECT_EQ(rows.back().id, 524);
+    rows.clear();
+    EXPECT_FALSE(db.readRecordRange(rows, 2000, 3000));
+
+    {
+        bd2::DataBase<Row, long> full(std::make_shared<bd2::DiskManager>("range_cut.index", true),
+                                      std::make_shared<bd2::DiskManager>("range_cut.dat", true), 0);
+        for (long i = 0; i < 1000; i++){
+            Row row{i, ""};
+            full.insertWithBPlusTreeIndex(row, row.id, true);
+        }
+    }
+    ASSERT_EQ(truncate("range_cut.dat", 500 * sizeof(Row)), 0); //the last records are lost
+    bd2::DataBase<Row, long> cut(std::make_shared<bd2::DiskManager>("range_cut.index"),
+                                 std::make_shared<bd2::DiskManager>("range_cut.dat"), 1000);
+    n = cut.scanRecordRange(0, 999, [](Row &row){
+        EXPECT_LT(row.id, 500);
+        return true;
+    });
+    EXPECT_EQ(n, 500);
+}
+
+TEST_F(DiskBasedBtree, ParallelIngestion){
+    struct Row {
+        long id;
+        char payload[56];
+    };
+    const long n = 20000;
+    std::vector<long> ids;
+    for (long i = 0; i < n; i++)
+        ids.push_back((i * 7919) % n); //the ids aren't sorted in the file
+    {
+        std::ofstream out("ingest.bin", std::ios::out | std::ios::binary | std::ios::trunc);
+        for (long id : ids){
+            Row row{id, ""};
+            snprintf(row.payload, sizeof(row.payload), "row %ld", id);
+            out.write((char *) &row, sizeof(row));
+        }
+    }
+    for (int kind = 0; kind < 2; kind++){
+        bd2::DataBase<Row, long> db(std::make_shared<bd2::DiskManager>(kind == 0 ? "ingest.index" : "ingest.bucket", true),
+                                    std::make_shared<bd2::DiskManager>("ingest.dat", true), 0, kind);
+        Row first{-1, "first"};
+        if (kind == 0)
+            db.insertWithBPlusTreeIndex(first, first.id, true); //the tree isn't empty, the runs are inserted
+        EXPECT_EQ(db.insertWithThreads("ingest.bin", 4), n);
+        for (long id = 0; id < n; id += 97){
+            Row row{};
+            if (kind == 0)
+                ASSERT_TRUE(db.readRecord(row, id));
+            else
+                ASSERT_TRUE(db.readRecord_SH(row, id));
+            EXPECT_EQ(row.id, id);
+            EXPECT_EQ(std::string(row.payload), "row " + std::to_string(id));
+        }
+        if (kind == 0){
+            long expected = -1;
+            db.scanRecordRange(-1, n, [&expected](Row &row){
+                EXPECT_EQ(row.id, expected++);
+                return true;
+            });
+            EXPECT_EQ(expected, n);
+        }
+    }
+
+    auto mapped = std::make_shared<bd2::DiskManager>("ingest.dat", true, bd2::DiskManager::MMAP);
+    bd2::DataBase<Row, long> bulk(std::make_shared<bd2::DiskManager>("ingest.index", true), mapped, 0);
+    bulk.loadFromExternalFile("ingest.bin", 0.7, 3); //bulk load of the empty tree
+    EXPECT_EQ(mapped->get_mode(), bd2::DiskManager::MMAP); //the workers wrote in POSITIONAL mode
+    EXPECT_EQ(mapped->count_records<Row>(), n);
+    std::vector<Row> rows;
+    EXPECT_TRUE(bulk.readRecordRange(rows, 100, 199));
+    ASSERT_EQ(rows.size(), 100);
+    EXPECT_EQ(rows[42].id, 142);
+    ASSERT_NE(mapped->borrow_record<Row>(0), nullptr);
+}
+
+TEST_F(DiskBasedBtree, ScanWithoutIndex){
+    struct Row {
+        long id;
+        char payload[56];
+    };
+    bd2::DataBase<Row, long> db = bd2::DataBase<Row, long>(2);
+    for (long i = 0; i < 50000; i++){
+        Row row{i % 20000, ""}; //each id is repeated
+        snprintf(row.payload, sizeof(row.payload), "row %ld", i);
+        db.insertWithoutIndex(row);
+    }
+    Row row{};
+    int disk_access = 0, blocks_read = 0;
+    db.findWithoutIndex(row, 19999, disk_access, &blocks_read);
+    EXPECT_EQ(row.id, 19999);
+    EXPECT_EQ(std::string(row.payload), "row 19999");
+    EXPECT_EQ(disk_access, 20000); //records read until the match
+    EXPECT_LE(blocks_read, 2); //the blocks after the first match aren't read
+    db.findWithoutIndex(row, 50000, disk_access);
+    EXPECT_EQ(disk_access, 50000);
+
+    for (int n_threads = 1; n_threads <= 4; n_threads += 3){
+        std::vector<long> all = db.scanKey(123, false, n_threads);
+        EXPECT_EQ(all, std::vector<long>({123, 20123, 40123}));
+        std::vector<long> first = db.scanKey(20123 % 20000, true, n_threads);
+        EXPECT_EQ(first, std::vector<long>({123}));
+        EXPECT_TRUE(db.scanKey(20000, false, n_threads).empty());
+    }
+}
+
+TEST_F(DiskBasedBtree, PredicateScan){
+    struct Weather {
+        int id;
+        char city [30];
+        char state [4];
+        double temperature;
+    };
+    const char *cities[] = {"Lima", "Cusco", "Arequipa", "Lambayeque"};
+    bd2::DataBase<Weather, int> db = bd2::DataBase<Weather, int>(2);
+    for (int i = 0; i < 40000; i++){
+        Weather row{i, "", "", i % 50 - 10.0};
+        strncpy(row.city, cities[i % 4], sizeof(row.city));
+        strncpy(row.state, i % 3 ? "LI" : "CU", sizeof(row.state));
+        db.insertWithoutIndex(row);
+    }
+    using city = BD2_FIELD(Weather, city);
+    using state = BD2_FIELD(Weather, state);
+    using temperature = BD2_FIELD(Weather, temperature);
+
+    for (int n_threads = 1; n_threads <= 4; n_threads += 3){
+        std::vector<long> lima = db.selectWhere(bd2::equals<city>("Lima"), n_threads);
+        ASSERT_EQ(lima.size(), 10000);
+        EXPECT_EQ(lima[1], 4);
+        EXPECT_EQ(db.selectWhere(bd2::prefix<city>("La"), n_threads).size(), 10000);
+        EXPECT_EQ(db.selectWhere(bd2::prefix<city>("L"), n_threads).size(), 20000);
+        EXPECT_EQ(db.selectWhere(bd2::between<temperature>(0, 9.5), n_threads).size(), 8000);
+        auto cusco_state = bd2::both(bd2::equals<city>("Cusco"), bd2::equals<state>("CU"));
+        long n = db.scanWhere(cusco_state, [](long pos, const Weather &row){
+            EXPECT_EQ(pos, row.id);
+            EXPECT_EQ(row.id % 12, 9);
+            return true;
+        }, n_threads);
+        EXPECT_EQ(n, 40000 / 12);
+        EXPECT_EQ(db.selectWhere(bd2::equals<city>("Tacna"), n_threads).size(), 0);
+    }
+    long n = db.scanWhere(bd2::equals<city>("Lima"), [](long, const Weather &){ return false; });
+    EXPECT_EQ(n, 1); //early termination
+}
+
+TEST_F(DiskBasedBtree, SecondaryIndexLookup){
+    struct Weather {
+        long id;
+        char city [30];
+        double temperature;
+    };
+    const char *cities[] = {"Lima", "Cusco", "Arequipa", "Lambayeque"};
+    bd2::DataBase<Weather, long> db = bd2::DataBase<Weather, long>();
+    for (long i = 0; i < 2000; i++){
+        Weather row{i, "", i % 50 - 10.0};
+        strncpy(row.city, cities[i % 4], sizeof(row.city));
+        db.insertWithBPlusTreeIndex(row, row.id, true);
+    }
+    using city = BD2_FIELD(Weather, city);
+    using temperature = BD2_FIELD(Weather, temperature);
+    auto by_city = db.addSecondaryIndex<city>("city.index"); //built from the stored records
+    for (long i = 2000; i < 4000; i++){
+        Weather row{i, "", i % 50 - 10.0};
+        strncpy(row.city, cities[i % 4], sizeof(row.city));
+        db.insertWithBPlusTreeIndex(row, row.id, true);
+    }
+    auto by_temperature = db.addSecondaryIndex<temperature>("temperature.index");
+
+    std::vector<long> lima = by_city->search(std::string("Lima"));
+    ASSERT_EQ(lima.size(), 1000);
+    EXPECT_TRUE(std::is_sorted(lima.begin(), lima.end())); //repeated values by record id
+    std::vector<Weather> rows;
+    EXPECT_EQ(db.readRecords(lima, rows), 1000);
+    for (auto &row : rows)
+        EXPECT_STREQ(row.city, "Lima");
+    EXPECT_EQ(by_city->search_by_range(std::string("C"), std::string("Lb")).size(), 2000);
+    EXPECT_EQ(by_city->search(std::string("Tacna")).size(), 0);
+
+    std::vector<long> warm = by_temperature->search_by_range(30.0, 39.0);
+    ASSERT_EQ(warm.size(), 800);
+    EXPECT_EQ(warm[0], 40); //ordered by temperature
+    long n = by_temperature->scan(-10.0, 39.0, [](long){ return false; });
+    EXPECT_EQ(n, 1); //early termination
+
+    for (long i = 0; i < 4000; i += 8)
+        EXPECT_TRUE(db.eraseWithBPlusTreeIndex(i));
+    EXPECT_EQ(by_city->search(std::string("Lima")).size(), 500);
+    EXPECT_EQ(by_city->search(std::string("Cusco")).size(), 1000);
+    EXPECT_EQ(by_temperature->search(30.0).size(), 60);
+}
+
+TEST_F(DiskBasedBtree, SecondaryIndexReachableRecords){
+    struct Weather {
+        long id;
+        char city [30];
+        double temperature;
+    };
+    using city = BD2_FIELD(Weather, city);
+    const char *index_files[] = {"reach.index", "reach.bucket"};
+    for (int kind = 0; kind < 2; kind++){
+        {
+            bd2::DataBase<Weather, long> db(std::make_shared<bd2::DiskManager>(index_files[kind], true),
+                                            std::make_shared<bd2::DiskManager>("reach.dat", true), 0, kind);
+            for (long i = 0; i < 100; i++){
+                Weather row{i, "", 20.0};
+                strncpy(row.city, i % 2 ? "Cusco" : "Lima", sizeof(row.city));
+                if (kind == 0)
+                    db.insertWithBPlusTreeIndex(row, row.id, true);
+                else
+                    db.insertWithStaticHashing(row);
+            }
+            for (long i = 1; i < 100; i += 2){
+                if (kind == 0)
+                    EXPECT_TRUE(db.eraseWithBPlusTreeIndex(i));
+                else
+                    EXPECT_TRUE(db.eraseWithStaticHashing(i));
+            }
+            auto by_city = db.addSecondaryIndex<city>("reach_city.index"); //the erased rows are still in the data file
+            EXPECT_EQ(by_city->search(std::string("Cusco")).size(), 0);
+            EXPECT_EQ(by_city->search(std::string("Lima")).size(), 50);
+        }
+        bd2::DataBase<Weather, long> db(std::make_shared<bd2::DiskManager>(index_files[kind]),
+                                        std::make_shared<bd2::DiskManager>("reach.dat"), 100, kind);
+        Weather row{100, "Lima", 20.0};
+        if (kind == 0)
+            db.insertWithBPlusTreeIndex(row, row.id, true);
+        else
+            db.insertWithStaticHashing(row);
+        auto by_city = db.addSecondaryIndex<city>("reach_city.index");
+        EXPECT_EQ(by_city->search(std::string("Lima")).size(), 50); //the file is reopened, not rebuilt
+    }
+}
+
 TEST_F(DiskBasedBtree, InsertFromCSV) {
     int n = 10;
     struct Default